@@ -41,6 +41,7 @@ binit(void)
   struct buf *b;
 
   initlock(&bcache.lock, "bcache");
+  lockstat(&bcache.lock);
 
 //PAGEBREAK!
   // Create linked list of buffers
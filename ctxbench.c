@@ -0,0 +1,97 @@
+// Context switch microbenchmark.
+//
+// Times two things with the cycle counter:
+//   yield:     a lone process yielding, so the scheduler picks the
+//              same process again (no %cr3 reload needed);
+//   ping-pong: two processes bouncing a byte over a pair of pipes,
+//              so every hop is a switch to a different process.
+// Run it before and after a scheduler/TLB change to compare.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define LOGN 12
+#define N    (1 << LOGN)
+
+static unsigned long long
+rdtsc(void)
+{
+  unsigned long long t;
+  asm volatile("rdtsc" : "=A" (t));
+  return t;
+}
+
+static void
+report(char *what, unsigned long long cycles, int shift)
+{
+  printf(1, "%s: %d cycles per op\n", what, (uint)(cycles >> shift));
+}
+
+void
+yieldbench(void)
+{
+  unsigned long long t0, t1;
+  int i;
+
+  t0 = rdtsc();
+  for(i = 0; i < N; i++)
+    yield();
+  t1 = rdtsc();
+  report("yield", t1 - t0, LOGN);
+}
+
+void
+pingpongbench(void)
+{
+  unsigned long long t0, t1;
+  int ping[2], pong[2];
+  char c;
+  int i, pid;
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "ctxbench: pipe failed\n");
+    exit();
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf(2, "ctxbench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    for(i = 0; i < N; i++){
+      if(read(ping[0], &c, 1) != 1)
+        break;
+      write(pong[1], &c, 1);
+    }
+    exit();
+  }
+
+  c = 'x';
+  t0 = rdtsc();
+  for(i = 0; i < N; i++){
+    write(ping[1], &c, 1);
+    if(read(pong[0], &c, 1) != 1)
+      break;
+  }
+  t1 = rdtsc();
+  wait();
+
+  // Each round trip is two switches.
+  report("ping-pong switch", t1 - t0, LOGN + 1);
+
+  close(ping[0]);
+  close(ping[1]);
+  close(pong[0]);
+  close(pong[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf(1, "ctxbench: %d iterations\n", N);
+  yieldbench();
+  pingpongbench();
+  exit();
+}
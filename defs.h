@@ -1,14 +1,20 @@
 struct buf;
 struct context;
+struct cpu;
 struct file;
 struct inode;
+struct lockstat;
 struct pipe;
 struct proc;
+struct profsample;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct trapframe;
+struct vmproc;
+struct vmstat;
 
 // bio.c
 void            binit(void);
@@ -56,10 +62,13 @@ int				createSwapFile(struct proc* p);
 int				readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size);
 int				writeToSwapFile(struct proc* p, char* buffer, uint placeOnFile, uint size);
 int				removeSwapFile(struct proc* p);
+int				pooledSwapFiles(void);
+void			cleanSwapFiles(void);
 int 			find_avail_page_index_in_file(struct proc * p);
-int 			page_out(struct proc * p, int vAddr, pde_t *pgdir);
+int 			find_avail_run_in_file(struct proc * p, int n);
+int 			page_out(struct proc * p, int vAddr, pde_t *pgdir, char* mem, int index);
 int 			page_in(struct proc * p, int ram_managerIndex, int vAddr, char* buff);
-void 			clone_file(struct proc* fromP, struct proc* toP);
+int 			clone_file(struct proc* fromP, struct proc* toP);
 
 // ide.c
 void            ideinit(void);
@@ -78,6 +87,15 @@ void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 int 			getTotalPages();
 int 			getFreePages();
+int 			getFailedAllocs();
+char*           kallochuge(void);
+void            kfreehuge(char*);
+int             getFreeHugePages(void);
+
+// kmalloc.c
+void            kmallocinit(void);
+void*           kmalloc(uint);
+void            kmfree(void*);
 
 // kbd.c
 void            kbdintr(void);
@@ -88,7 +106,10 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(uchar, int);
 void            lapicstartap(uchar, uint);
+void            lapictimer(uint);
+uint            lapictsc(void);
 void            microdelay(int);
 
 // log.c
@@ -97,6 +118,19 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mmap.c
+void            pcacheinit(void);
+void            pcachewrote(struct inode*, uint, uint);
+int             mmap(struct file*, uint, int, int, uint);
+int             munmap(uint, uint);
+void            mmapclose(struct proc*);
+int             mmapfork(struct proc*, struct proc*);
+int             mmapfault(struct proc*, uint, int);
+void            mmapdrop(struct proc*, uint);
+uint            mmapend(struct proc*, uint);
+void            mmapfaultin(struct proc*, uint, uint);
+int             mmapwritable(struct proc*, uint, uint);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
@@ -111,14 +145,23 @@ void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
+// prof.c
+void            profinit(void);
+void            profsample(struct trapframe*);
+int             profctl(int, struct profsample*, int);
+
 //PAGEBREAK: 16
 // proc.c
 int             cpuid(void);
+void            cpuwake(struct cpu*);
 void            exit(void);
 int             fork(void);
 int             growproc(int);
+int             growhuge(int);
 int             kill(int);
 struct cpu*     mycpu(void);
+void            mlfqboost(void);
+int             mlfqtick(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
@@ -129,10 +172,16 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
+void            wakeupone(void*);
 void            yield(void);
+void            lockpagemap(struct proc*);
+void            unlockpagemap(struct proc*);
+void            lockswap(struct proc*);
+void            unlockswap(struct proc*);
 int 			is_shell_or_init(struct proc* p);
-void 			update_access_trackers_for_all(void);
-void 			update_adv_queues_for_all(void);
+void 			update_policies_for_all(void);
+void 			restart_default_policy(void);
+void 			procvmstat(struct vmstat* st, struct vmproc* vp, int n);
 int 			getNumOfPagesInMem(struct proc* p);
 int 			getNumOfPagesInFile(struct proc* p);
 int 			generate_creation_number(struct proc* p);
@@ -151,6 +200,8 @@ void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            lockstat(struct spinlock*);
+int             getlockstat(struct lockstat*, int);
 void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
@@ -172,20 +223,30 @@ char*           strncpy(char*, const char*, int);
 
 // syscall.c
 int             argint(int, int*);
+int             argaddr(int, char**, int);
 int             argptr(int, char**, int);
-int             argstr(int, char**);
+int             argwptr(int, char**, int);
+int             argstr(int, char*, int);
 int             fetchint(uint, int*);
-int             fetchstr(uint, char**);
+int             fetchstr(uint, char*, int);
 void            syscall(void);
 
 // timer.c
 void            timerinit(void);
+void            timertick(void);
+void            timerbusy(void);
+void            timeridle(void);
+int             timersleep(int);
+extern uint     ticks;
+extern struct spinlock tickslock;
 
 // trap.c
 void            idtinit(void);
-extern uint     ticks;
 void            tvinit(void);
-extern struct spinlock tickslock;
+
+// trace.c
+void            traceinit(void);
+void            trace(int, struct proc*, uint, uint);
 
 // uart.c
 void            uartinit(void);
@@ -193,23 +254,32 @@ void            uartintr(void);
 void            uartputc(int);
 
 // vm.c
+uint*           walkpgdir(pde_t*, const void*, int);
 void            seginit(void);
 void            kvmalloc(void);
 pde_t*          setupkvm(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
+int             allocstack(pde_t*, uint, uint);
+int             growstack(struct proc*, uint);
 int             deallocuvm(pde_t*, uint, uint);
+int             allochuge(pde_t*, uint, uint);
+int             deallochuge(pde_t*, uint, uint);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
+void            kvmenable(void);
+void            resumeuvm(struct proc*);
+void            retirepgdir(pde_t*);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 
 int 			swap_in(struct proc* p, int cr2);
 void 			swap(struct proc* p, pde_t *pgdir, uint vAddr);
+int 			swap_out_batch(struct proc* p, int n);
 void 			add_page_to_ram(struct proc* p, pde_t *pgdir, uint vAddr);
 int 			find_avail_index_in_ram_manger(struct proc* p);
 int 			is_page_in_file(struct proc* p, int vAddr);
@@ -217,16 +287,34 @@ void 			update_pageOUT_pte_flags(struct proc* p, int vAddr, pde_t * pgdir);
 int 			acquire_pAddr(int vAddr, pde_t * pgdir);
 int 			find_avail_page_index_to_swapout(struct proc* p);
 int 			check_NONE_policy(void);
+struct page_policy* 	proc_policy(struct proc* p);
+int 			setpolicy(struct proc* p, int policy, int global);
+void 			init_policy(struct proc* p);
+void 			restart_policy(struct proc* p);
 void 			update_pageIN_pte_flags(struct proc* p, int vAddr, int pagePAddr, pde_t * pgdir);
 void 			update_access_trackers(struct proc* p);
 void 			update_adv_queues(struct proc* p);
-uint 			countNumOfOneBits(uint n);
-int 			findNextAdvPageIndex(struct proc* p, int boundery);
-int 			findMinAdvPageIndex(struct proc* p);
 int 			find_avail_index_by_AQ(struct proc* p);
 int 			find_avail_index_by_SCFIFO(struct proc* p);
 int 			find_avail_index_by_LAPA(struct proc* p);
 int 			find_avail_index_by_NFUA(struct proc* p);
+int 			find_avail_index_by_ARC(struct proc* p);
+void 			remove_page_from_ram(struct proc* p, uint vAddr, pde_t *pgdir);
+void 			remove_page_from_file(struct proc* p, uint vAddr, pde_t *pgdir);
+int 			track_page(struct proc* p, uint vAddr);
+int 			find_page_in_ram(struct proc* p, uint vAddr);
+int 			mlock(struct proc* p, uint addr, uint len);
+int 			munlock(struct proc* p, uint addr, uint len);
+int 			iopin(struct proc* p, uint addr, uint n);
+void 			iounpin(struct proc* p);
+int 			is_zero_fill_page(struct proc* p, int vAddr);
+int 			zero_fill_in(struct proc* p, int vAddr);
+int 			page_advice(struct proc* p, uint vAddr);
+int 			find_hinted_victim(struct proc* p);
+int 			madvise(struct proc* p, uint addr, uint len, int advice);
+
+// vmdev.c
+void            vmstatinit(void);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
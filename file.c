@@ -150,6 +150,8 @@ filewrite(struct file *f, char *addr, int n)
         panic("short filewrite");
       i += r;
     }
+    if(i > 0)
+      pcachewrote(f->ip, f->off - i, i);
     return i == n ? n : -1;
   }
   panic("filewrite");
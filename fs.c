@@ -18,6 +18,7 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
+#include "trace.h"
 #include "buf.h"
 #include "file.h"
 
@@ -169,12 +170,23 @@ struct {
   struct inode inode[NINODE];
 } icache;
 
+// Swap files of exited processes, kept open (and linked as
+// /.swap<id>) for the next process that pages out.  They are
+// truncated first, so the pool holds no data blocks.
+struct {
+  struct spinlock lock;
+  struct file *file[NSWAPPOOL];
+  int id[NSWAPPOOL];
+  int n;
+} swappool;
+
 void
 iinit(int dev)
 {
   int i = 0;
   
   initlock(&icache.lock, "icache");
+  initlock(&swappool.lock, "swappool");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].lock, "inode");
   }
@@ -694,26 +706,19 @@ char* itoa(int i, char b[]){
     }while(i);
     return b;
 }
-//remove swap file of proc p;
-int
-removeSwapFile(struct proc* p)
+//unlink swap file /.swap<id>
+static int
+unlinkSwapFile(int id)
 {
-  //path of proccess
   char path[DIGITS];
   memmove(path,"/.swap", 6);
-  itoa(p->pid, path+ 6);
+  itoa(id, path+ 6);
 
   struct inode *ip, *dp;
   struct dirent de;
   char name[DIRSIZ];
   uint off;
 
-  if(0 == p->swapFile)
-  {
-    return -1;
-  }
-  fileclose(p->swapFile);
-
   begin_op();
   if((dp = nameiparent(path, name)) == 0)
   {
@@ -762,15 +767,110 @@ removeSwapFile(struct proc* p)
 
 }
 
+//unlink the swap files an earlier boot left on disk;
+//called once, from the first process (see forkret)
+void
+cleanSwapFiles(void)
+{
+  struct inode *dp = iget(ROOTDEV, ROOTINO);
+  struct dirent de;
+  uint off;
+  char *s;
+  int id;
+
+  for(off = 0; ; off += sizeof(de)){
+    ilock(dp);
+    if(off >= dp->size){
+      iunlock(dp);
+      break;
+    }
+    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+      panic("cleanSwapFiles: readi");
+    iunlock(dp);
+    if(de.inum == 0 || strncmp(de.name, ".swap", 5) != 0)
+      continue;
+    id = 0;
+    for(s = de.name + 5; s < de.name + DIRSIZ && *s >= '0' && *s <= '9'; s++)
+      id = id*10 + *s - '0';
+    if(s == de.name + 5 || (s < de.name + DIRSIZ && *s != 0))
+      continue; //not a name unlinkSwapFile makes
+    unlinkSwapFile(id);
+  }
+
+  begin_op();
+  iput(dp);
+  end_op();
+}
+
+//number of swap files kept in the pool for reuse
+int
+pooledSwapFiles(void)
+{
+  return swappool.n;
+}
+
+//remove swap file of proc p;
+//it is emptied and goes back to the pool if there is room
+int
+removeSwapFile(struct proc* p)
+{
+  struct file *f = p->swapFile;
+
+  if(0 == f)
+  {
+    return 0; //never paged out
+  }
+  p->swapFile = 0;
 
+  // Its pages are garbage: free their blocks before the file waits in the pool.
+  begin_op();
+  ilock(f->ip);
+  itrunc(f->ip);
+  iunlock(f->ip);
+  end_op();
+
+  acquire(&swappool.lock);
+  if(swappool.n < NSWAPPOOL){
+    swappool.file[swappool.n] = f;
+    swappool.id[swappool.n] = p->swapid;
+    swappool.n++;
+    release(&swappool.lock);
+    return 0;
+  }
+  release(&swappool.lock);
+
+  fileclose(f);
+  return unlinkSwapFile(p->swapid);
+}
+
+
+//create the swap file of proc p on its first page out (reusing one from the pool if possible);
 //return 0 on success
 int
 createSwapFile(struct proc* p)
 {
 
+  if(p->swapFile)
+    return 0;
+
+  // Its old pages are garbage, but file_manager says which pages are there.
+  acquire(&swappool.lock);
+  if(swappool.n > 0){
+    swappool.n--;
+    p->swapFile = swappool.file[swappool.n];
+    p->swapid = swappool.id[swappool.n];
+    release(&swappool.lock);
+    return 0;
+  }
+  release(&swappool.lock);
+
+  // pids are not reused within a boot, and cleanSwapFiles removed the
+  // files of earlier boots, so no other file has this name
+  p->swapid = p->pid;
+
   char path[DIGITS];
   memmove(path,"/.swap", 6);
-  itoa(p->pid, path+ 6);
+  itoa(p->swapid, path+ 6);
 
     begin_op();
     struct inode * in = create(path, T_FILE, 0, 0);
@@ -810,7 +910,8 @@ readFromSwapFile(struct proc * p, char* buffer, uint placeOnFile, uint size)
 }
 
 /*
-* Reads from page in swapfile corresponding to vAddr into buff
+* Reads from page in swapfile corresponding to vAddr into buff.
+* Caller holds lockswap(p).
 */
 int page_in(struct proc* p, int ram_managerIndex, int vAddr, char* buff) {
 
@@ -820,9 +921,14 @@ int page_in(struct proc* p, int ram_managerIndex, int vAddr, char* buff) {
       ret = readFromSwapFile(p, buff, i*PGSIZE, PGSIZE);
       if (ret == -1)
         break; //error in read
+      trace(TR_PAGEIN, p, vAddr, i);
+      lockpagemap(p);
       p->ram_manager[ram_managerIndex] = p->file_manager[i];
       p->ram_manager[ram_managerIndex].create_order = generate_creation_number(p);
       p->ram_manager[ram_managerIndex].adv_queue = generate_adv_number(p);
+      p->ram_manager[ram_managerIndex].cached = 0;
+      p->ram_manager[ram_managerIndex].pinned = 0;
+      unlockpagemap(p);
       p->file_manager[i].state = NOT_USED;
       return ret;
     }
@@ -834,15 +940,23 @@ int page_in(struct proc* p, int ram_managerIndex, int vAddr, char* buff) {
 
 // Our addition
 /*
-* Writes a page in memory starting from vAddr to a available place in file
+* Writes the page vAddr of pgdir, whose contents are at the kernel address mem,
+* to place index in file (or to any available place if index is -1).
+* Caller holds lockswap(p).
 */
-int page_out(struct proc * p, int vAddr, pde_t *pgdir) {
+int page_out(struct proc * p, int vAddr, pde_t *pgdir, char* mem, int index) {
   
+  // The swapfile is only created when it is needed
+  if (createSwapFile(p) != 0)
+    return -1;
+
   // Get an index of an available place in swapfile of proc p
-  int index = find_avail_page_index_in_file(p);
+  if (index < 0)
+    index = find_avail_page_index_in_file(p);
   
-  if(writeToSwapFile(p, (char*)vAddr, PGSIZE*index, PGSIZE) == -1)
+  if(writeToSwapFile(p, mem, PGSIZE*index, PGSIZE) == -1)
     return -1;
+  trace(TR_PAGEOUT, p, vAddr, index);
   
   p->file_manager[index].pgdir = pgdir;
   p->file_manager[index].vAddr = vAddr;
@@ -867,23 +981,59 @@ int find_avail_page_index_in_file(struct proc * p) {
   return -1;
 }
 
-void clone_file(struct proc* src, struct proc* dest){
+/*
+* Finds n consecutive unused page spaces in swapfile and returns the index of the first
+*/
+int find_avail_run_in_file(struct proc * p, int n) {
+
+  int run = 0;
+  for (int i=0; i < MAX_FILE_PAGES; i++) {
+    run = p->file_manager[i].state == NOT_USED ? run + 1 : 0;
+    if (n > 0 && run == n)
+      return i - n + 1;
+  }
+
+  // If got here then there is no such run
+  return -1;
+}
+
+// Copy src's swapped-out pages into dest's swap file.
+// Return 0 on success, -1 if dest's copy could not be made.
+int clone_file(struct proc* src, struct proc* dest){
   
-  if (is_shell_or_init(src))
-    return;
-
-  char buff[PGSIZE];
-  for (int i=0; i < MAX_FILE_PAGES; i++){
-    if (src->file_manager[i].state == USED){
-      if (readFromSwapFile(src, buff, PGSIZE*i, PGSIZE) != PGSIZE)
-        panic("clone_file: error in reading from file");
-      
-      if (writeToSwapFile(dest, buff, PGSIZE*i, PGSIZE) != PGSIZE)
-        panic("clone_file: error in writing to file");
+  if (is_shell_or_init(src) || src->swapFile == 0)
+    return 0;
 
-      dest->file_manager[i].state = USED;
+  if (createSwapFile(dest) != 0)
+    return -1;
+
+  // A page-sized buffer does not fit on the kernel stack.
+  char *buff = kmalloc(PGSIZE);
+  if (buff == 0)
+    return -1;
+
+  lockswap(src);
+  int last = -1;
+  for (int i=0; i < MAX_FILE_PAGES; i++)
+    if (src->file_manager[i].state == USED)
+      last = i;
+
+  // dest's file is empty and writei can not leave holes,
+  // so the free places below the last page are copied too.
+  for (int i=0; i <= last; i++){
+    if (readFromSwapFile(src, buff, PGSIZE*i, PGSIZE) != PGSIZE ||
+        writeToSwapFile(dest, buff, PGSIZE*i, PGSIZE) != PGSIZE){
+      unlockswap(src);
+      kmfree(buff);
+      return -1;
     }
+
+    if (src->file_manager[i].state == USED)
+      dest->file_manager[i].state = USED;
   }
+  unlockswap(src);
+  kmfree(buff);
+  return 0;
 }
 
 
@@ -12,6 +12,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -53,6 +54,7 @@ ideinit(void)
   int i;
 
   initlock(&idelock, "ide");
+  lockstat(&idelock);
   ioapicenable(IRQ_IDE, ncpu - 1);
   idewait(0);
 
@@ -114,14 +116,16 @@ ideintr(void)
   }
   idequeue = b->qnext;
 
+  trace(TR_IODONE, 0, b->blockno, (b->flags & B_DIRTY) != 0);
+
   // Read data if needed.
   if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
     insl(0x1f0, b->data, BSIZE/4);
 
-  // Wake process waiting for this buf.
+  // Wake process waiting for this buf (only its lock holder waits).
   b->flags |= B_VALID;
   b->flags &= ~B_DIRTY;
-  wakeup(b);
+  wakeupone(b);
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
@@ -147,6 +151,7 @@ iderw(struct buf *b)
     panic("iderw: ide disk 1 not present");
 
   acquire(&idelock);  //DOC:acquire-lock
+  trace(TR_IOSTART, 0, b->blockno, (b->flags & B_DIRTY) != 0);
 
   // Append b to idequeue.
   b->qnext = 0;
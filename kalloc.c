@@ -14,15 +14,20 @@ extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 
 int numOfFreePages = 0;
+int numOfFailedAllocs = 0;
 
 int getTotalPages(){
-  return PGROUNDDOWN(PHYSTOP-V2P(end))/PGSIZE;
+  return PGROUNDDOWN(PHYSTOP-V2P(end))/PGSIZE - NHUGEPAGES*NPTENTRIES;
 }
 
 int getFreePages(){
   return numOfFreePages;
 }
 
+int getFailedAllocs(){
+  return numOfFailedAllocs;
+}
+
 struct run {
   struct run *next;
 };
@@ -31,6 +36,8 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  char *huge[NHUGEPAGES];  // 4 MB frames set aside by kinit2
+  int nhuge;               // how many of them are free
 } kmem;
 
 // Initialization happens in two phases.
@@ -42,6 +49,7 @@ void
 kinit1(void *vstart, void *vend)
 {
   initlock(&kmem.lock, "kmem");
+  lockstat(&kmem.lock);
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -49,7 +57,16 @@ kinit1(void *vstart, void *vend)
 void
 kinit2(void *vstart, void *vend)
 {
-  freerange(vstart, vend);
+  char *h;
+
+  // Keep the top of memory back as physically contiguous,
+  // 4 MB aligned frames for huge user pages.
+  h = (char*)((uint)vend & ~(PGSIZE4M-1)) - NHUGEPAGES*PGSIZE4M;
+  if(h < (char*)vstart)
+    panic("kinit2: no room for huge pages");
+  freerange(vstart, h);
+  for(kmem.nhuge = 0; kmem.nhuge < NHUGEPAGES; kmem.nhuge++, h += PGSIZE4M)
+    kmem.huge[kmem.nhuge] = h;
   kmem.use_lock = 1;
 }
 
@@ -99,12 +116,46 @@ kalloc(void)
   if(kmem.use_lock)
     acquire(&kmem.lock);
 
-  numOfFreePages--;
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    numOfFreePages--;
+  } else
+    numOfFailedAllocs++;
   if(kmem.use_lock)
     release(&kmem.lock);
   return (char*)r;
 }
 
+// Allocate one physically contiguous 4 MB frame, 4 MB aligned.
+// Returns 0 if none is left.
+char*
+kallochuge(void)
+{
+  char *h;
+
+  acquire(&kmem.lock);
+  h = 0;
+  if(kmem.nhuge > 0)
+    h = kmem.huge[--kmem.nhuge];
+  release(&kmem.lock);
+  return h;
+}
+
+// Free a frame returned by kallochuge().
+void
+kfreehuge(char *h)
+{
+  if((uint)h % PGSIZE4M || V2P(h) >= PHYSTOP)
+    panic("kfreehuge");
+
+  acquire(&kmem.lock);
+  if(kmem.nhuge >= NHUGEPAGES)
+    panic("kfreehuge: pool overflow");
+  kmem.huge[kmem.nhuge++] = h;
+  release(&kmem.lock);
+}
+
+int getFreeHugePages(){
+  return kmem.nhuge;
+}
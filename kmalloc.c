@@ -0,0 +1,224 @@
+// Kernel object allocator, layered on kalloc().
+//
+// Objects of up to KMMAXOBJ bytes are rounded up to a power-of-two
+// size class and carved out of kalloc() pages ("slabs"), so that a
+// pipe or a small kernel buffer no longer takes a whole page.  Each
+// slab starts with a struct slab header; since objects follow the
+// header, a slab object is never page aligned, which is how kmfree()
+// tells slab objects apart from whole pages.
+//
+// Requests larger than KMMAXOBJ (up to PGSIZE) get a whole page
+// straight from kalloc().
+//
+// Each CPU keeps a small stack of recently freed objects per class,
+// so the common alloc/free pair touches neither the class lock nor
+// the slab lists.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+#define KMMINSHIFT 5                  // smallest class is 32 bytes
+#define KMNCLASS   6                  // 32, 64, ..., 1024
+#define KMMAXOBJ   (1 << (KMMINSHIFT + KMNCLASS - 1))
+#define KMCACHE    8                  // objects cached per CPU per class
+
+struct kmobj {
+  struct kmobj *next;
+};
+
+struct slab {
+  struct slab *next;      // next slab with free objects in this class
+  int cls;                // size class of the objects in this slab
+  int inuse;              // objects handed out (including CPU caches)
+  struct kmobj *free;     // free objects in this slab
+};
+
+struct kmclass {
+  struct spinlock lock;
+  uint size;
+  struct slab *partial;   // slabs with at least one free object
+};
+
+struct kmcpucache {
+  int n;
+  void *obj[KMCACHE];
+};
+
+static struct kmclass kmclass[KMNCLASS];
+static struct kmcpucache kmcpu[NCPU][KMNCLASS];
+
+void
+kmallocinit(void)
+{
+  int i;
+
+  for(i = 0; i < KMNCLASS; i++){
+    initlock(&kmclass[i].lock, "kmalloc");
+    kmclass[i].size = 1 << (KMMINSHIFT + i);
+    kmclass[i].partial = 0;
+  }
+}
+
+static int
+sizeclass(uint n)
+{
+  int i;
+
+  for(i = 0; i < KMNCLASS; i++)
+    if(n <= kmclass[i].size)
+      return i;
+  return -1;
+}
+
+// Carve a fresh page into objects of class cls.
+// Caller holds kmclass[cls].lock.
+static struct slab*
+slabgrow(int cls)
+{
+  struct slab *s;
+  struct kmobj *o;
+  char *a, *mem;
+  uint size;
+
+  if((mem = kalloc()) == 0)
+    return 0;
+  size = kmclass[cls].size;
+  s = (struct slab*)mem;
+  s->cls = cls;
+  s->inuse = 0;
+  s->free = 0;
+  // Objects follow the header, so none of them is page aligned.
+  a = mem + ((sizeof(*s) + 15) & ~15);
+  for(; a + size <= mem + PGSIZE; a += size){
+    o = (struct kmobj*)a;
+    o->next = s->free;
+    s->free = o;
+  }
+  s->next = kmclass[cls].partial;
+  kmclass[cls].partial = s;
+  return s;
+}
+
+// Take one object of class cls from the slab lists.
+// Caller holds kmclass[cls].lock.
+static void*
+slaballoc(int cls)
+{
+  struct slab *s;
+  struct kmobj *o;
+
+  if((s = kmclass[cls].partial) == 0 && (s = slabgrow(cls)) == 0)
+    return 0;
+  o = s->free;
+  s->free = o->next;
+  s->inuse++;
+  if(s->free == 0)
+    kmclass[cls].partial = s->next;
+  return o;
+}
+
+// Return one object to its slab, giving the page back to
+// kalloc() once the slab is entirely free.
+// Caller holds kmclass[cls].lock.
+static void
+slabfree(int cls, void *v)
+{
+  struct slab *s, **pp;
+  struct kmobj *o;
+
+  s = (struct slab*)PGROUNDDOWN((uint)v);
+  if(s->cls != cls || s->inuse <= 0)
+    panic("slabfree");
+  o = (struct kmobj*)v;
+  if(s->free == 0){
+    s->next = kmclass[cls].partial;
+    kmclass[cls].partial = s;
+  }
+  o->next = s->free;
+  s->free = o;
+  if(--s->inuse > 0)
+    return;
+
+  for(pp = &kmclass[cls].partial; *pp; pp = &(*pp)->next){
+    if(*pp == s){
+      *pp = s->next;
+      break;
+    }
+  }
+  kfree((char*)s);
+}
+
+// Allocate n bytes of kernel memory.  The memory is not zeroed.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmalloc(uint n)
+{
+  struct kmcpucache *c;
+  void *v;
+  int cls;
+
+  if(n == 0 || n > PGSIZE)
+    return 0;
+  if(n > KMMAXOBJ)
+    return kalloc();
+
+  cls = sizeclass(n);
+  pushcli();
+  c = &kmcpu[cpuid()][cls];
+  if(c->n > 0){
+    v = c->obj[--c->n];
+    popcli();
+    return v;
+  }
+
+  // Refill half of the CPU cache while we hold the class lock.
+  acquire(&kmclass[cls].lock);
+  v = slaballoc(cls);
+  while(v && c->n < KMCACHE/2){
+    void *o = slaballoc(cls);
+    if(o == 0)
+      break;
+    c->obj[c->n++] = o;
+  }
+  release(&kmclass[cls].lock);
+  popcli();
+  return v;
+}
+
+// Free memory returned by kmalloc().
+void
+kmfree(void *v)
+{
+  struct kmcpucache *c;
+  struct slab *s;
+  int cls;
+
+  if((uint)v % PGSIZE == 0){
+    kfree(v);
+    return;
+  }
+
+  s = (struct slab*)PGROUNDDOWN((uint)v);
+  cls = s->cls;
+  if(cls < 0 || cls >= KMNCLASS)
+    panic("kmfree");
+
+  // Fill with junk to catch dangling refs.
+  memset(v, 1, kmclass[cls].size);
+
+  pushcli();
+  c = &kmcpu[cpuid()][cls];
+  if(c->n == KMCACHE){
+    // Spill half of the CPU cache back to the slabs.
+    acquire(&kmclass[cls].lock);
+    while(c->n > KMCACHE/2)
+      slabfree(cls, c->obj[--c->n]);
+    release(&kmclass[cls].lock);
+  }
+  c->obj[c->n++] = v;
+  popcli();
+}
@@ -0,0 +1,168 @@
+// Profile the kernel while a command runs:
+//
+//   kprof command [args...]
+//
+// Samples where each CPU was at every timer interrupt (see prof.c)
+// and prints a flat profile: kernel samples by the function in
+// kernel.sym they fell in, then the samples taken in user mode.
+
+#include "types.h"
+#include "stat.h"
+#include "fcntl.h"
+#include "user.h"
+#include "prof.h"
+
+#define NDRAIN 256
+
+struct sym {
+  uint addr;
+  char *name;
+  int count;
+};
+
+static struct sym *syms;
+static int nsyms;
+
+static uint
+hex(char *s, char **end)
+{
+  uint v = 0;
+
+  for(;; s++){
+    if(*s >= '0' && *s <= '9')
+      v = v*16 + *s - '0';
+    else if(*s >= 'a' && *s <= 'f')
+      v = v*16 + *s - 'a' + 10;
+    else
+      break;
+  }
+  *end = s;
+  return v;
+}
+
+// Read the "address name" lines of kernel.sym, sorted by address.
+static int
+loadsyms(char *path)
+{
+  struct stat st;
+  struct sym t;
+  char *buf, *p, *end;
+  int fd, i, j, n;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  if(fstat(fd, &st) < 0 || (buf = malloc(st.size + 1)) == 0){
+    close(fd);
+    return -1;
+  }
+  for(i = 0; i < st.size; i += n)
+    if((n = read(fd, buf + i, st.size - i)) <= 0)
+      break;
+  close(fd);
+  buf[i] = 0;
+
+  n = 1;
+  for(p = buf; *p; p++)
+    if(*p == '\n')
+      n++;
+  syms = malloc(n * sizeof(*syms));
+
+  for(p = buf; *p; p = end){
+    t.addr = hex(p, &end);
+    if(*end == ' ')
+      end++;
+    t.name = end;
+    while(*end && *end != '\n')
+      end++;
+    if(*end)
+      *end++ = 0;
+    t.count = 0;
+    if(t.addr < 0x80000000 || *t.name == 0)
+      continue;   // a file name, or not kernel text
+    // Insertion sort: kernel.sym is mostly in order already.
+    for(j = nsyms; j > 0 && syms[j-1].addr > t.addr; j--)
+      syms[j] = syms[j-1];
+    syms[j] = t;
+    nsyms++;
+  }
+  return 0;
+}
+
+// The symbol at or below addr, or 0.
+static struct sym*
+lookup(uint addr)
+{
+  int lo = 0, hi = nsyms;
+
+  while(hi - lo > 1){
+    int mid = (lo + hi) / 2;
+    if(syms[mid].addr <= addr)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  if(nsyms == 0 || syms[lo].addr > addr)
+    return 0;
+  return &syms[lo];
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct profsample *s;
+  struct sym *sym;
+  int i, n, pid, total, user, unknown, lost, best;
+
+  if(argc < 2){
+    printf(2, "usage: kprof command [args...]\n");
+    exit();
+  }
+  if(loadsyms("kernel.sym") < 0 && loadsyms("/kernel.sym") < 0){
+    printf(2, "kprof: cannot read kernel.sym\n");
+    exit();
+  }
+  s = malloc(NDRAIN * sizeof(*s));
+
+  prof(PROF_START, 0, 0);
+  if((pid = fork()) == 0){
+    exec(argv[1], argv+1);
+    printf(2, "kprof: exec %s failed\n", argv[1]);
+    exit();
+  }
+  if(pid > 0)
+    wait();
+  lost = prof(PROF_STOP, 0, 0);
+
+  total = user = unknown = 0;
+  while((n = prof(PROF_DRAIN, s, NDRAIN)) > 0){
+    for(i = 0; i < n; i++){
+      total++;
+      if(s[i].user)
+        user++;
+      else if((sym = lookup(s[i].eip)) != 0)
+        sym->count++;
+      else
+        unknown++;
+    }
+  }
+
+  printf(1, "%d samples, %d lost\n", total, lost);
+  if(total == 0)
+    exit();
+  printf(1, "samples     %%  function\n");
+  for(;;){
+    best = -1;
+    for(i = 0; i < nsyms; i++)
+      if(syms[i].count > 0 && (best < 0 || syms[i].count > syms[best].count))
+        best = i;
+    if(best < 0)
+      break;
+    printf(1, "%d\t%d\t%s\n", syms[best].count,
+           syms[best].count * 100 / total, syms[best].name);
+    syms[best].count = 0;
+  }
+  if(unknown)
+    printf(1, "%d\t%d\t(unknown kernel)\n", unknown, unknown * 100 / total);
+  printf(1, "%d\t%d\t(user)\n", user, user * 100 / total);
+  exit();
+}
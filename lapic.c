@@ -31,7 +31,7 @@
 #define ICRHI   (0x0310/4)   // Interrupt Command [63:32]
 #define TIMER   (0x0320/4)   // Local Vector Table 0 (TIMER)
   #define X1         0x0000000B   // divide counts by 1
-  #define PERIODIC   0x00020000   // Periodic
+  #define PERIODIC   0x00020000   // Periodic (one-shot if clear)
 #define PCINT   (0x0340/4)   // Performance Counter LVT
 #define LINT0   (0x0350/4)   // Local Vector Table 1 (LINT0)
 #define LINT1   (0x0360/4)   // Local Vector Table 2 (LINT1)
@@ -43,6 +43,12 @@
 
 volatile uint *lapic;  // Initialized in mp.c
 
+// Timer counts per second.  QEMU's APIC bus runs at 1 GHz; if xv6
+// cared more about precise timekeeping, this would be calibrated
+// using an external time source.
+#define LAPICHZ    1000000000
+#define TICKCOUNT  (LAPICHZ / TICKHZ)   // timer counts per tick
+
 //PAGEBREAK!
 static void
 lapicw(int index, int value)
@@ -60,13 +66,12 @@ lapicinit(void)
   // Enable local APIC; set spurious interrupt vector.
   lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
-  // The timer repeatedly counts down at bus frequency
-  // from lapic[TICR] and then issues an interrupt.
-  // If xv6 cared more about precise timekeeping,
-  // TICR would be calibrated using an external time source.
+  // The timer counts down once at bus frequency from lapic[TICR]
+  // and then issues an interrupt.  It stays stopped until
+  // lapictimer() arms it: an idle CPU takes no timer interrupts.
   lapicw(TDCR, X1);
-  lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-  lapicw(TICR, 10000000);
+  lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+  lapicw(TICR, 0);
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
@@ -113,6 +118,50 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Send interrupt vector to the CPU with the given APIC ID.
+// Interrupts must be off, so that ICRHI and ICRLO go together.
+void
+lapicipi(uchar apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
+// Interrupt this CPU once, n ticks from now; n == 0 stops the timer.
+// A delay too long for the counter fires early.
+void
+lapictimer(uint n)
+{
+  if(!lapic)
+    return;
+  if(n > 0xFFFFFFFF / TICKCOUNT)
+    n = 0xFFFFFFFF / TICKCOUNT;
+  lapicw(TICR, n * TICKCOUNT);
+}
+
+// Count the TSC cycles in one tick of the (stopped) timer,
+// which runs with its interrupt masked meanwhile.
+uint
+lapictsc(void)
+{
+  unsigned long long t0;
+
+  if(!lapic)
+    return 0;
+  lapicw(TIMER, MASKED | (T_IRQ0 + IRQ_TIMER));
+  t0 = rdtsc();
+  lapicw(TICR, TICKCOUNT);
+  while(lapic[TCCR] != 0)
+    ;
+  t0 = rdtsc() - t0;
+  lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+  return t0;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
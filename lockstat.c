@@ -0,0 +1,33 @@
+// Print the statistics of the hot kernel spinlocks:
+// acquisitions, how many had to wait and for how long,
+// and how long the lock was held.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "lockstat.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat st[NLOCKSTAT];
+  int i, b, n;
+
+  if((n = getlockstat(st, NLOCKSTAT)) < 0){
+    printf(2, "lockstat: getlockstat failed\n");
+    exit();
+  }
+
+  printf(1, "lock        acquires  contended  spin(kcyc)  hold: ");
+  for(b = 0; b < NLOCKHIST-1; b++)
+    printf(1, "<2^%d ", 2*b+8);
+  printf(1, "more\n");
+  for(i = 0; i < n; i++){
+    printf(1, "%s\t%d\t%d\t%d\t", st[i].name, st[i].acquires,
+           st[i].contended, st[i].spinkc);
+    for(b = 0; b < NLOCKHIST; b++)
+      printf(1, " %d", st[i].hold[b]);
+    printf(1, "\n");
+  }
+  exit();
+}
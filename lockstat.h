@@ -0,0 +1,12 @@
+// Statistics of the hot spinlocks, read with getlockstat().
+#define NLOCKSTAT   8   // most locks with statistics
+#define NLOCKHIST   8   // hold-time buckets: bucket i counts holds of
+                        // under 1<<(2*i+8) cycles, the last one the rest
+
+struct lockstat {
+  char name[16];
+  uint acquires;               // times acquired
+  uint contended;              // times acquire() had to wait
+  uint spinkc;                 // cycles spent waiting, in units of 1024
+  uint hold[NLOCKHIST];        // hold times, by bucket
+};
@@ -3,8 +3,11 @@
 #include "param.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "mmu.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -58,6 +61,7 @@ initlog(int dev)
 
   struct superblock sb;
   initlock(&log.lock, "log");
+  lockstat(&log.lock);
   readsb(dev, &sb);
   log.start = sb.logstart;
   log.size = sb.nlog;
@@ -134,6 +138,8 @@ begin_op(void)
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      myproc()->logop++;
+      trace(TR_BEGINOP, 0, log.outstanding, 0);
       release(&log.lock);
       break;
     }
@@ -149,6 +155,7 @@ end_op(void)
 
   acquire(&log.lock);
   log.outstanding -= 1;
+  myproc()->logop--;
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
@@ -165,6 +172,7 @@ end_op(void)
   if(do_commit){
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
+    trace(TR_COMMIT, 0, log.lh.n, 0);
     commit();
     acquire(&log.lock);
     log.committing = 0;
@@ -0,0 +1,6 @@
+#define MADV_NORMAL     0  // no hint, plain replacement policy
+#define MADV_RANDOM     1  // no useful order; plain replacement policy
+#define MADV_SEQUENTIAL 2  // pages behind the last fault are evicted first
+#define MADV_WILLNEED   3  // bring swapped-out pages back in now
+#define MADV_DONTNEED   4  // drop the contents; next touch reads zeros
+#define MADV_COLD       5  // evict these pages before any others
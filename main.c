@@ -18,18 +18,24 @@ int
 main(void)
 {
   kinit1(end, P2V(4*1024*1024)); // phys page allocator
+  kmallocinit();   // small object allocator
   kvmalloc();      // kernel page table
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
+  timerinit();     // clock
   seginit();       // segment descriptors
   picinit();       // disable pic
   ioapicinit();    // another interrupt controller
   consoleinit();   // console hardware
   uartinit();      // serial port
   pinit();         // process table
+  profinit();      // sampling profiler
+  traceinit();     // event trace device
+  vmstatinit();    // paging statistics device
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  pcacheinit();    // mmap() page cache
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -41,7 +47,7 @@ main(void)
 static void
 mpenter(void)
 {
-  switchkvm();
+  kvmenable();
   seginit();
   lapicinit();
   mpmain();
@@ -8,6 +8,13 @@
 #define KERNBASE 0x80000000         // First kernel virtual address
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
 
+// User regions outside the heap (0..sz)
+#define HUGEBASE 0x40000000         // 4 MB pages handed out by hugesbrk()
+#define HUGETOP  0x50000000
+#define MMAPBASE 0x50000000         // files mapped by mmap()
+#define MMAPTOP  0x60000000
+#define STACKTOP KERNBASE           // user stack, grown down on demand
+
 #define V2P(a) (((uint) (a)) - KERNBASE)
 #define P2V(a) (((void *) (a)) + KERNBASE)
 
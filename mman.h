@@ -0,0 +1,5 @@
+#define PROT_READ   0x1  // pages may be read
+#define PROT_WRITE  0x2  // pages may be written
+
+#define MAP_SHARED  0x1  // writes go to the file and are seen by other mappings
+#define MAP_PRIVATE 0x2  // writes are copied to private pages
@@ -0,0 +1,533 @@
+// Memory-mapped files.
+//
+// mmap() maps pages of a file between MMAPBASE and MMAPTOP.  Nothing
+// is mapped up front: pages are faulted in from a page cache keyed by
+// (inode, offset), so a MAP_SHARED page is the cache page itself and
+// every process mapping that part of the file shares one frame, with
+// no copy to or from user memory.  A MAP_PRIVATE page maps the cache
+// page read-only and gets a private copy on the first write.
+//
+// Writes through shared mappings are picked up from the PTE dirty bit
+// when a page is unmapped, and written back to the file once its last
+// mapping goes away or when the cache needs the slot.
+//
+// Resident cache pages are listed in the process' ram_manager like any
+// other page, with .cached set.  When the replacement policy picks one,
+// it is just unmapped (mmapdrop) instead of being written to the swapfile.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "fs.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "mman.h"
+
+struct pcpage {
+  struct inode *ip;    // 0 if the slot is free
+  uint off;            // page-aligned offset in ip
+  char *mem;
+  int ref;             // PTEs mapping mem
+  int dirty;           // mem is newer than the file
+  uint lastuse;
+};
+
+// Reading and writing back pages sleeps, so the cache is
+// protected by a sleep lock.
+static struct {
+  struct sleeplock lock;
+  struct pcpage page[NPCACHE];
+  uint clock;
+} pcache;
+
+void
+pcacheinit(void)
+{
+  initsleeplock(&pcache.lock, "pcache");
+}
+
+// Write pg back to its file, but never past the end of the file.
+// A few blocks at a time, like filewrite().
+// Caller holds pcache.lock.
+static void
+pcwriteback(struct pcpage *pg)
+{
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+  uint i, n;
+
+  if(!pg->dirty)
+    return;
+  pg->dirty = 0;
+  for(i = 0; i < PGSIZE; i += n){
+    begin_op();
+    ilock(pg->ip);
+    n = 0;
+    if(pg->off + i < pg->ip->size){
+      n = pg->ip->size - (pg->off + i);
+      if(n > max)
+        n = max;
+      if(n > PGSIZE - i)
+        n = PGSIZE - i;
+      writei(pg->ip, pg->mem + i, pg->off + i, n);
+    }
+    iunlock(pg->ip);
+    end_op();
+    if(n == 0)
+      break;
+  }
+}
+
+// Free an unmapped cache page.
+// Caller holds pcache.lock.
+static void
+pcevict(struct pcpage *pg)
+{
+  pcwriteback(pg);
+  kfree(pg->mem);
+  begin_op();
+  iput(pg->ip);
+  end_op();
+  pg->ip = 0;
+}
+
+// Return the cache page holding offset off of ip, reading it in
+// if needed.  Recycles the least recently used unmapped page when
+// the cache (or memory) is full.  Returns 0 if nothing can be recycled.
+// Caller holds pcache.lock.
+static struct pcpage*
+pcget(struct inode *ip, uint off)
+{
+  struct pcpage *pg, *free, *old;
+  int n;
+
+  free = old = 0;
+  for(pg = pcache.page; pg < &pcache.page[NPCACHE]; pg++){
+    if(pg->ip == ip && pg->off == off){
+      pg->lastuse = ++pcache.clock;
+      return pg;
+    }
+    if(pg->ip == 0){
+      if(free == 0)
+        free = pg;
+    } else if(pg->ref == 0 && (old == 0 || pg->lastuse < old->lastuse))
+      old = pg;
+  }
+
+  if(free == 0){
+    if(old == 0)
+      return 0;
+    pcevict(old);
+    free = old;
+    old = 0;
+  }
+  if((free->mem = kalloc()) == 0){
+    if(old == 0)
+      return 0;
+    pcevict(old);
+    if((free->mem = kalloc()) == 0)
+      return 0;
+  }
+
+  ilock(ip);
+  n = readi(ip, free->mem, off, PGSIZE);
+  iunlock(ip);
+  if(n < 0)
+    n = 0;
+  memset(free->mem + n, 0, PGSIZE - n);
+
+  free->ip = idup(ip);
+  free->off = off;
+  free->ref = 0;
+  free->dirty = 0;
+  free->lastuse = ++pcache.clock;
+  return free;
+}
+
+// Return the cache page whose memory is mem, or 0 if mem
+// is not a cache page (e.g. a private copy).
+// Caller holds pcache.lock.
+static struct pcpage*
+pcfind(char *mem)
+{
+  struct pcpage *pg;
+
+  for(pg = pcache.page; pg < &pcache.page[NPCACHE]; pg++)
+    if(pg->ip && pg->mem == mem)
+      return pg;
+  return 0;
+}
+
+// Drop one mapping of pg; dirty says whether it was
+// written through that mapping.
+// Caller holds pcache.lock.
+static void
+pcput(struct pcpage *pg, int dirty)
+{
+  if(pg->ref <= 0)
+    panic("pcput");
+  if(dirty)
+    pg->dirty = 1;
+  if(--pg->ref == 0)
+    pcwriteback(pg);
+}
+
+// Keep cached pages of ip in step with n bytes that write()
+// just wrote at off.
+void
+pcachewrote(struct inode *ip, uint off, uint n)
+{
+  struct pcpage *pg;
+  uint lo, hi;
+
+  acquiresleep(&pcache.lock);
+  for(pg = pcache.page; pg < &pcache.page[NPCACHE]; pg++){
+    if(pg->ip != ip || pg->off >= off + n || off >= pg->off + PGSIZE)
+      continue;
+    lo = off > pg->off ? off : pg->off;
+    hi = off + n < pg->off + PGSIZE ? off + n : pg->off + PGSIZE;
+    ilock(ip);
+    readi(ip, pg->mem + (lo - pg->off), lo, hi - lo);
+    iunlock(ip);
+  }
+  releasesleep(&pcache.lock);
+}
+
+static struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->mmaps; v < &p->mmaps[NMMAP]; v++)
+    if(v->start && v->start <= va && va < v->end)
+      return v;
+  return 0;
+}
+
+// Unmap the pages of p between start and end, which lie in one mapping.
+// Caller holds pcache.lock.
+static void
+unmaprange(struct proc *p, uint start, uint end)
+{
+  struct pcpage *pg;
+  pte_t *pte;
+  char *mem;
+  uint a;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0){
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(*pte & PTE_P){
+      mem = P2V(PTE_ADDR(*pte));
+      if((pg = pcfind(mem)) != 0)
+        pcput(pg, *pte & PTE_D);
+      else
+        kfree(mem);
+      remove_page_from_ram(p, a, p->pgdir);
+    } else if(*pte & PTE_PG)
+      remove_page_from_file(p, a, p->pgdir);
+    *pte = 0;
+  }
+  if(p == myproc())
+    lcr3(V2P(p->pgdir));
+}
+
+// Map len bytes of f, starting at file offset off, somewhere
+// between MMAPBASE and MMAPTOP.  Returns the address, or -1.
+int
+mmap(struct file *f, uint len, int prot, int flags, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *u;
+  uint start;
+
+  if(f->type != FD_INODE || f->ip->type != T_FILE || !f->readable)
+    return -1;
+  if(len == 0 || len > MMAPTOP - MMAPBASE || off % PGSIZE != 0)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if(flags == MAP_SHARED && (prot & PROT_WRITE) && !f->writable)
+    return -1;
+  len = PGROUNDUP(len);
+
+  for(v = p->mmaps; v < &p->mmaps[NMMAP]; v++)
+    if(v->start == 0)
+      break;
+  if(v == &p->mmaps[NMMAP])
+    return -1;
+
+  // First fit.
+  start = MMAPBASE;
+again:
+  for(u = p->mmaps; u < &p->mmaps[NMMAP]; u++){
+    if(u->start && u->start < start + len && start < u->end){
+      start = u->end;
+      goto again;
+    }
+  }
+  if(start + len > MMAPTOP)
+    return -1;
+
+  v->start = start;
+  v->end = start + len;
+  v->off = off;
+  v->prot = prot;
+  v->flags = flags;
+  v->f = filedup(f);
+  return start;
+}
+
+// Unmap addr..addr+len, which must be the whole of a mapping,
+// its head or its tail.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+  uint end;
+
+  end = PGROUNDUP(addr + len);
+  if(addr % PGSIZE != 0 || len == 0 || end < addr)
+    return -1;
+  if((v = findvma(p, addr)) == 0 || end > v->end)
+    return -1;
+  if(addr != v->start && end != v->end)
+    return -1;
+
+  acquiresleep(&pcache.lock);
+  unmaprange(p, addr, end);
+  releasesleep(&pcache.lock);
+
+  if(addr == v->start && end == v->end){
+    fileclose(v->f);
+    v->start = v->end = 0;
+    v->f = 0;
+  } else if(addr == v->start){
+    v->off += end - v->start;
+    v->start = end;
+  } else
+    v->end = addr;
+  return 0;
+}
+
+// Unmap everything p has mapped, at exit() and exec().
+void
+mmapclose(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->mmaps; v < &p->mmaps[NMMAP]; v++){
+    if(v->start == 0)
+      continue;
+    acquiresleep(&pcache.lock);
+    unmaprange(p, v->start, v->end);
+    releasesleep(&pcache.lock);
+    fileclose(v->f);
+    v->start = v->end = 0;
+    v->f = 0;
+  }
+}
+
+// Give child np the mappings of p.  Shared pages and unwritten
+// private pages map the same cache page; private copies are copied.
+// Swapped-out private copies are already in the cloned swapfile.
+int
+mmapfork(struct proc *np, struct proc *p)
+{
+  struct pcpage *pg;
+  struct vma *v;
+  pte_t *pte, *npte;
+  char *mem;
+  uint a;
+
+  for(v = p->mmaps; v < &p->mmaps[NMMAP]; v++){
+    if(v->start == 0)
+      continue;
+    np->mmaps[v - p->mmaps] = *v;
+    filedup(v->f);
+  }
+
+  acquiresleep(&pcache.lock);
+  for(v = p->mmaps; v < &p->mmaps[NMMAP]; v++){
+    if(v->start == 0)
+      continue;
+    for(a = v->start; a < v->end; a += PGSIZE){
+      if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0){
+        a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+        continue;
+      }
+      if(!(*pte & (PTE_P|PTE_PG)))
+        continue;
+      if((npte = walkpgdir(np->pgdir, (char*)a, 1)) == 0)
+        goto bad;
+      if(!(*pte & PTE_P)){
+        *npte = PTE_FLAGS(*pte);
+        continue;
+      }
+      mem = P2V(PTE_ADDR(*pte));
+      if((pg = pcfind(mem)) != 0){
+        pg->ref++;
+        *npte = *pte & ~PTE_D;
+        continue;
+      }
+      if((mem = kalloc()) == 0)
+        goto bad;
+      memmove(mem, P2V(PTE_ADDR(*pte)), PGSIZE);
+      *npte = V2P(mem) | PTE_FLAGS(*pte);
+    }
+  }
+  releasesleep(&pcache.lock);
+  return 0;
+
+bad:
+  releasesleep(&pcache.lock);
+  mmapclose(np);
+  return -1;
+}
+
+// Map in the page of an mmap()ed file at va, on a page fault.
+// Returns 0 if va is not mapped or the access is not allowed.
+int
+mmapfault(struct proc *p, uint va, int write)
+{
+  struct pcpage *pg;
+  struct vma *v;
+  pte_t *pte;
+  char *mem;
+  int perm, cached, i;
+
+  if((v = findvma(p, va)) == 0)
+    return 0;
+  if(write && !(v->prot & PROT_WRITE))
+    return 0;
+  va = PGROUNDDOWN(va);
+  if((pte = walkpgdir(p->pgdir, (char*)va, 1)) == 0)
+    return 0;
+
+  if(*pte & PTE_P){
+    // First write to a private page: copy it out of the cache.
+    if(!write || v->flags != MAP_PRIVATE || (*pte & PTE_W))
+      return 0;
+    if((mem = kalloc()) == 0)
+      return 0;
+    acquiresleep(&pcache.lock);
+    memmove(mem, P2V(PTE_ADDR(*pte)), PGSIZE);
+    if((pg = pcfind(P2V(PTE_ADDR(*pte)))) != 0)
+      pcput(pg, 0);
+    releasesleep(&pcache.lock);
+    *pte = V2P(mem) | PTE_P | PTE_W | PTE_U;
+    for(i = 0; i < MAX_PSYC_PAGES; i++)
+      if(p->ram_manager[i].state == USED && p->ram_manager[i].vAddr == va &&
+         p->ram_manager[i].pgdir == p->pgdir)
+        p->ram_manager[i].cached = 0;
+    lcr3(V2P(p->pgdir));
+    return 1;
+  }
+  if(*pte & PTE_PG)
+    return 0;
+
+  acquiresleep(&pcache.lock);
+  if((pg = pcget(v->f->ip, v->off + (va - v->start))) == 0){
+    releasesleep(&pcache.lock);
+    return 0;
+  }
+  if(write && v->flags == MAP_PRIVATE){
+    if((mem = kalloc()) == 0){
+      releasesleep(&pcache.lock);
+      return 0;
+    }
+    memmove(mem, pg->mem, PGSIZE);
+    perm = PTE_W;
+    cached = 0;
+  } else {
+    mem = pg->mem;
+    pg->ref++;
+    perm = (v->flags == MAP_SHARED && (v->prot & PROT_WRITE)) ? PTE_W : 0;
+    cached = 1;
+  }
+  releasesleep(&pcache.lock);
+
+  // May evict another page of p to make room.
+  p->scan_ptr = va;
+  if((i = track_page(p, va)) >= 0)
+    p->ram_manager[i].cached = cached;
+
+  *pte = V2P(mem) | perm | PTE_P | PTE_U;
+  lcr3(V2P(p->pgdir));
+  return 1;
+}
+
+// Unmap the cache page at va, which the replacement
+// policy picked to leave memory.
+void
+mmapdrop(struct proc *p, uint va)
+{
+  struct pcpage *pg;
+  pte_t *pte;
+
+  if((pte = walkpgdir(p->pgdir, (char*)va, 0)) == 0 || !(*pte & PTE_P))
+    panic("mmapdrop");
+  acquiresleep(&pcache.lock);
+  if((pg = pcfind(P2V(PTE_ADDR(*pte)))) == 0)
+    panic("mmapdrop: not cached");
+  pcput(pg, *pte & PTE_D);
+  releasesleep(&pcache.lock);
+  *pte = 0;
+  lcr3(V2P(p->pgdir));
+}
+
+// Return the end of the mapping of p that contains va, or 0.
+uint
+mmapend(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  if((v = findvma(p, va)) == 0)
+    return 0;
+  return v->end;
+}
+
+// Fault in addr..addr+n of a mapping before the kernel
+// uses it as a system call buffer.
+void
+mmapfaultin(struct proc *p, uint addr, uint n)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+  int write;
+
+  if((v = findvma(p, addr)) == 0)
+    return;
+  write = (v->prot & PROT_WRITE) != 0;
+  for(a = PGROUNDDOWN(addr); a < addr + n && a < v->end; a += PGSIZE){
+    if(is_page_in_file(p, a)){
+      swap_in(p, a);
+      continue;
+    }
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if(pte && (*pte & PTE_P) && (!write || (*pte & PTE_W)))
+      continue;
+    mmapfault(p, a, write);
+  }
+}
+
+// Whether the kernel may write addr..addr+n, i.e. it
+// is not in a read-only mapping.
+int
+mmapwritable(struct proc *p, uint addr, uint n)
+{
+  struct vma *v;
+
+  if((v = findvma(p, addr)) == 0)
+    return 1;
+  return (v->prot & PROT_WRITE) != 0;
+}
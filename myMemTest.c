@@ -2,6 +2,11 @@
 #include "stat.h"
 #include "user.h"
 #include "param.h"
+#include "madvise.h"
+#include "mman.h"
+#include "fcntl.h"
+#include "policy.h"
+#include "vmstat.h"
 #include <math.h>
 
 #define PGSIZE      4096
@@ -168,6 +173,452 @@ void test4(){
 }
 
 
+/*
+* Maps a 4MB huge page, signs every 4KB page inside it, and checks that a
+* forked child sees a private copy of it (child's writes do not reach the father).
+*/
+void test5(){
+
+	int testNum = 5;
+	printf(1, "TEST %d:\n", testNum);
+
+	int hugeSize = 1024*PGSIZE;
+	char* huge = hugesbrk(hugeSize);
+	if(huge == (char*)-1){
+		printf(1, "no huge pages available, skipping\n");
+		return;
+	}
+
+	for (int i=0; i < hugeSize; i += PGSIZE)
+		huge[i] = (char)(i/PGSIZE);
+
+	if(fork() == 0){
+		for (int i=0; i < hugeSize; i += PGSIZE){
+			if(huge[i] != (char)(i/PGSIZE)){
+				printf(1, "SON FAILED!\n");
+				exit();
+			}
+			huge[i] = 0;
+		}
+		printf(1, "SON PASSED!\n");
+		exit();
+	}
+
+	wait();
+
+	for (int i=0; i < hugeSize; i += PGSIZE){
+		if(huge[i] != (char)(i/PGSIZE)){
+			printf(1, "FAILED!\n");
+			return;
+		}
+	}
+	printf(1, "FATHER PASSED!\n");
+
+	hugesbrk(-hugeSize);
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+
+/*
+* Drops pages with MADV_DONTNEED (some of them swapped out), which should read back as zeros
+*/
+void test6(){
+
+	int testNum = 6;
+	printf(1, "TEST %d:\n", testNum);
+
+	int pages = 24;
+	char* mem = sbrk(pages*PGSIZE);
+	mem = (char*)(((uint)mem + PGSIZE-1) & ~(PGSIZE-1));
+	pages--;
+
+	for (int i=0; i < pages; i++)
+		mem[i*PGSIZE] = 'a';
+
+	madvise(mem, PGSIZE*pages/2, MADV_COLD);
+	if(madvise(mem, PGSIZE*pages, MADV_DONTNEED) < 0){
+		printf(1, "FAILED!\n");
+		return;
+	}
+
+	for (int i=0; i < pages; i++){
+		if(mem[i*PGSIZE] != 0){
+			printf(1, "FAILED!\n");
+			return;
+		}
+		mem[i*PGSIZE] = 'b';
+	}
+
+	madvise(mem, PGSIZE*pages, MADV_WILLNEED);
+	for (int i=0; i < pages; i++){
+		if(mem[i*PGSIZE] != 'b'){
+			printf(1, "FAILED!\n");
+			return;
+		}
+	}
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* Maps a file shared and private: shared writes should reach the file, private ones should not
+*/
+void test7(){
+
+	int testNum = 7;
+	printf(1, "TEST %d:\n", testNum);
+
+	int pages = 3;
+	char buf[512];
+	int fd = open("mmaptest", O_CREATE | O_RDWR);
+	for (int i=0; i < pages*PGSIZE; i += sizeof(buf)){
+		memset(buf, 'a' + i/PGSIZE, sizeof(buf));
+		write(fd, buf, sizeof(buf));
+	}
+
+	char* shared = mmap(0, pages*PGSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	char* private = mmap(0, pages*PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(shared == (char*)-1 || private == (char*)-1){
+		printf(1, "FAILED!\n");
+		return;
+	}
+
+	for (int i=0; i < pages; i++){
+		if(shared[i*PGSIZE] != 'a' + i || private[i*PGSIZE + 1] != 'a' + i){
+			printf(1, "FAILED!\n");
+			return;
+		}
+	}
+
+	shared[PGSIZE] = 'X';
+	private[2*PGSIZE] = 'Y';
+	if(private[PGSIZE] != 'X' || shared[2*PGSIZE] != 'c'){
+		printf(1, "FAILED!\n");
+		return;
+	}
+
+	munmap(shared, pages*PGSIZE);
+	munmap(private, pages*PGSIZE);
+	close(fd);
+
+	fd = open("mmaptest", O_RDONLY);
+	for (int i=0; i < pages; i++){
+		read(fd, buf, sizeof(buf));
+		if(buf[0] != (i == 1 ? 'X' : 'a' + i)){
+			printf(1, "FAILED!\n");
+			return;
+		}
+		for (int j=sizeof(buf); j < PGSIZE; j += sizeof(buf))
+			read(fd, buf, sizeof(buf));
+	}
+	close(fd);
+	unlink("mmaptest");
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* Pins pages with mlock() while touching many others, pinned data should survive
+* and locking more than half of the memory should be refused
+*/
+void test8(){
+
+	int testNum = 8;
+	printf(1, "TEST %d:\n", testNum);
+
+	int pages = 24;
+	char* mem = sbrk(pages*PGSIZE);
+	mem = (char*)(((uint)mem + PGSIZE-1) & ~(PGSIZE-1));
+	pages--;
+
+	for (int i=0; i < pages; i++)
+		mem[i*PGSIZE] = (char)i;
+
+	if(mlock(mem, 4*PGSIZE) < 0){
+		printf(1, "FAILED!\n");
+		return;
+	}
+	#ifndef NONE
+	if(mlock(mem, pages*PGSIZE) == 0){
+		printf(1, "FAILED!\n");
+		return;
+	}
+	#endif
+
+	for (int round=0; round < 3; round++){
+		for (int i=4; i < pages; i++)
+			mem[i*PGSIZE] = (char)i;
+	}
+
+	for (int i=0; i < pages; i++){
+		if(mem[i*PGSIZE] != (char)i){
+			printf(1, "FAILED!\n");
+			return;
+		}
+	}
+	munlock(mem, 4*PGSIZE);
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* Runs the same workload under every policy, chosen at runtime with setpolicy()
+*/
+void test9(){
+
+	int testNum = 9;
+	printf(1, "TEST %d:\n", testNum);
+
+	for (int policy=POLICY_NFUA; policy < NPOLICY; policy++){
+		if(fork() == 0){
+			if(setpolicy(policy, 0) < 0){
+				#ifndef NONE
+				printf(1, "FAILED!\n");
+				#endif
+				exit();
+			}
+
+			int pages = 24;
+			char* mem = sbrk(pages*PGSIZE);
+			for (int round=0; round < 2; round++)
+				for (int i=0; i < pages; i++)
+					mem[i*PGSIZE] = (char)(i + round);
+
+			for (int i=0; i < pages; i++){
+				if(mem[i*PGSIZE] != (char)(i + 1)){
+					printf(1, "FAILED with policy %d!\n", policy);
+					exit();
+				}
+			}
+			exit();
+		}
+		wait();
+	}
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* Returns how many page faults process pid took so far, from the vmstat device
+*/
+int faults_of(int pid){
+
+	char* buf = malloc(4096);
+	int fd, faults = -1;
+
+	if((fd = open("vmstat", O_RDONLY)) < 0){
+		mknod("vmstat", VMSTAT, 0);
+		fd = open("vmstat", O_RDONLY);
+	}
+	if(fd >= 0 && read(fd, buf, 4096) >= (int)sizeof(struct vmstat)){
+		struct vmstat* st = (struct vmstat*)buf;
+		struct vmproc* vp = (struct vmproc*)(st + 1);
+		for (int i=0; i < st->nproc; i++)
+			if(vp[i].pid == pid)
+				faults = vp[i].faults;
+	}
+	close(fd);
+	free(buf);
+	return faults;
+}
+
+/*
+* Runs a hot set of 6 pages, with a scan of 14 other pages after every round, under
+* policy in a child, and returns how many page faults it took (-1 if it went wrong).
+* The child waits on a pipe until its faults are counted.
+*/
+int hot_scan_faults(int policy){
+
+	int done[2], go[2], pid, faults;
+	char ok = 0;
+
+	if(pipe(done) < 0 || pipe(go) < 0)
+		return -1;
+
+	if((pid = fork()) == 0){
+		close(go[1]);
+		if(setpolicy(policy, 0) >= 0){
+			int hot = 6, scan = 14;
+			char* mem = sbrk((hot + scan)*PGSIZE);
+			for (int round=0; round < 8; round++){
+				for (int i=0; i < hot; i++)
+					for (int j=0; j < 4; j++)
+						mem[i*PGSIZE + j] = (char)(i + round);
+				for (int i=hot; i < hot + scan; i++)
+					mem[i*PGSIZE] = (char)(i + round);
+			}
+			ok = 1;
+			for (int i=0; i < hot + scan; i++)
+				if(mem[i*PGSIZE] != (char)(i + 7))
+					ok = 0;
+		}
+		write(done[1], &ok, 1);
+		read(go[0], &ok, 1);
+		exit();
+	}
+
+	close(done[1]);
+	close(go[0]);
+	faults = -1;
+	if(read(done[0], &ok, 1) == 1 && ok)
+		faults = faults_of(pid);
+	close(go[1]);
+	close(done[0]);
+	wait();
+	return faults;
+}
+
+/*
+* ARC keeps the hot set in memory while the scans pass through, so it should
+* take fewer page faults than SCFIFO, which lets every scan flush the hot set
+*/
+void test10(){
+
+	int testNum = 10;
+	printf(1, "TEST %d:\n", testNum);
+
+	#ifndef NONE
+	int arc = hot_scan_faults(POLICY_ARC);
+	int scfifo = hot_scan_faults(POLICY_SCFIFO);
+	if(arc < 0 || scfifo < 0 || arc >= scfifo){
+		printf(1, "FAILED! ARC took %d page faults, SCFIFO %d\n", arc, scfifo);
+		return;
+	}
+	#endif
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+void test11(){
+
+	int testNum = 11;
+	printf(1, "TEST %d:\n", testNum);
+
+	if(fork() == 0){
+		/*
+		* one sbrk far beyond MAX_PSYC_PAGES: the overflow is swapped out in batches
+		*/
+		int pages = 24;
+		char* mem = sbrk(pages*PGSIZE);
+		for (int i=0; i < pages; i++)
+			mem[i*PGSIZE] = (char)i;
+
+		for (int round=0; round < 2; round++){
+			for (int i=0; i < pages; i++){
+				if(mem[i*PGSIZE] != (char)(i + round)){
+					printf(1, "FAILED at page %d!\n", i);
+					exit();
+				}
+				mem[i*PGSIZE] = (char)(i + round + 1);
+			}
+		}
+		exit();
+	}
+	wait();
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* each call keeps a 1KB frame on the stack, and checks it after the deeper calls returned
+*/
+int recurse(int depth){
+
+	char frame[1024];
+	int sum;
+
+	for (int i=0; i < sizeof(frame); i++)
+		frame[i] = (char)(depth + i);
+	sum = depth > 0 ? recurse(depth - 1) : 0;
+	for (int i=0; i < sizeof(frame); i++)
+		if(frame[i] != (char)(depth + i))
+			return -1;
+	return sum < 0 ? -1 : sum + 1;
+}
+
+void test12(){
+
+	int testNum = 12;
+	printf(1, "TEST %d:\n", testNum);
+
+	if(fork() == 0){
+		/*
+		* about 10 pages of stack, grown on demand, while the heap keeps memory full
+		*/
+		int pages = 12;
+		char* mem = sbrk(pages*PGSIZE);
+		for (int i=0; i < pages; i++)
+			mem[i*PGSIZE] = (char)i;
+
+		if(recurse(40) != 41){
+			printf(1, "FAILED!\n");
+			exit();
+		}
+		for (int i=0; i < pages; i++){
+			if(mem[i*PGSIZE] != (char)i){
+				printf(1, "FAILED at page %d!\n", i);
+				exit();
+			}
+		}
+		exit();
+	}
+	wait();
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
+/*
+* Passes read() and write() buffers on stack pages that nothing touched yet (as the
+* frame of a deeper call would be): the kernel grows the stack over them first
+*/
+void test13(){
+
+	int testNum = 13;
+	printf(1, "TEST %d:\n", testNum);
+
+	if(fork() == 0){
+		int n = 2*PGSIZE, fd;
+		char* data = malloc(n);
+		for (int i=0; i < n; i++)
+			data[i] = (char)i;
+		if((fd = open("stackio", O_CREATE | O_RDWR)) < 0 || write(fd, data, n) != n){
+			printf(1, "FAILED!\n");
+			exit();
+		}
+		close(fd);
+
+		// well below the stack pointer, so not mapped yet
+		char here;
+		char* in = &here - 6*PGSIZE;
+		char* out = &here - 10*PGSIZE;
+
+		fd = open("stackio", O_RDONLY);
+		if(read(fd, in, n) != n){
+			printf(1, "FAILED to read!\n");
+			exit();
+		}
+		close(fd);
+		for (int i=0; i < n; i++){
+			if(in[i] != (char)i){
+				printf(1, "FAILED at byte %d!\n", i);
+				exit();
+			}
+		}
+
+		fd = open("stackio", O_WRONLY);
+		if(write(fd, out, n) != n){
+			printf(1, "FAILED to write!\n");
+			exit();
+		}
+		close(fd);
+		unlink("stackio");
+		exit();
+	}
+	wait();
+
+	printf(2, "TEST %d PASSED!\n\n", testNum);
+}
+
 void TEST(void (*test)(void)){
 	if(fork() == 0){
 		test();
@@ -193,6 +644,15 @@ void runTests(){
 		TEST(test2);
 		TEST(test3);
 		TEST(test4);
+		TEST(test5);
+		TEST(test6);
+		TEST(test7);
+		TEST(test8);
+		TEST(test9);
+		TEST(test10);
+		TEST(test11);
+		TEST(test12);
+		TEST(test13);
 
 		exit();
 	}
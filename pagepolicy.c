@@ -0,0 +1,324 @@
+// Page replacement algorithms; see pagepolicy.h.
+//
+// This file is built both into the kernel and into the host
+// simulator, so it must not call anything but its arguments.
+
+#include "types.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "pagepolicy.h"
+
+uint
+pp_popcount(uint x)
+{
+  uint n;
+
+  for(n = 0; x; x &= x - 1)
+    n++;
+  return n;
+}
+
+// NFUA: the page with the smallest aging counter.
+int
+pp_victim_NFUA(struct page_struct *pages, int n)
+{
+  int i, min = -1;
+
+  for(i = 0; i < n; i++){
+    if(!PP_USABLE(&pages[i]))
+      continue;
+    if(min == -1 || pages[i].access_tracker < pages[min].access_tracker)
+      min = i;
+  }
+  return min;
+}
+
+// LAPA: the page referenced on the fewest recent ticks.
+int
+pp_victim_LAPA(struct page_struct *pages, int n)
+{
+  int i, min = -1;
+  uint c, minc = 0;
+
+  for(i = 0; i < n; i++){
+    if(!PP_USABLE(&pages[i]))
+      continue;
+    c = pp_popcount(pages[i].access_tracker);
+    if(min == -1 || c < minc){
+      min = i;
+      minc = c;
+    }
+  }
+  return min;
+}
+
+// SCFIFO: the oldest page, but a referenced page gets a second
+// chance: its bit is cleared and it goes to the back of the queue.
+// *order hands out queue positions.
+int
+pp_victim_SCFIFO(struct page_struct *pages, int n, refbit_fn refbit, uint *order)
+{
+  int i, min, tries;
+
+  for(tries = 0; ; tries++){
+    min = -1;
+    for(i = 0; i < n; i++){
+      if(!PP_USABLE(&pages[i]))
+        continue;
+      if(min == -1 || pages[i].create_order < pages[min].create_order)
+        min = i;
+    }
+    // After a full round every bit is clear, so this ends.
+    if(min == -1 || tries > n || !refbit(&pages[min], 1))
+      return min;
+    pages[min].create_order = (*order)++;
+  }
+}
+
+// AQ: the page at the back of the advancing queue.
+int
+pp_victim_AQ(struct page_struct *pages, int n)
+{
+  int i, min = -1;
+
+  for(i = 0; i < n; i++){
+    if(!PP_USABLE(&pages[i]))
+      continue;
+    if(min == -1 || pages[i].adv_queue < pages[min].adv_queue)
+      min = i;
+  }
+  return min;
+}
+
+// Clock tick for NFUA and LAPA: shift each aging counter right,
+// with the referenced bit going into the top.
+void
+pp_age(struct page_struct *pages, int n, refbit_fn refbit)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(pages[i].state != USED)
+      continue;
+    pages[i].access_tracker >>= 1;
+    if(refbit(&pages[i], 1))
+      pages[i].access_tracker |= 0x80000000;
+  }
+}
+
+// Clock tick for AQ: walk the queue from the back, and let each
+// referenced page advance one place, past an unreferenced page just
+// in front of it.  New pages join at the back (generate_adv_number()).
+void
+pp_advance(struct page_struct *pages, int n, refbit_fn refbit)
+{
+  int i, cur, next, moved, tmp;
+
+  cur = -1;
+  moved = 0;
+  for(;;){
+    // next = the page just in front of cur
+    next = -1;
+    for(i = 0; i < n; i++){
+      if(pages[i].state != USED)
+        continue;
+      if(cur != -1 && pages[i].adv_queue <= pages[cur].adv_queue)
+        continue;
+      if(next == -1 || pages[i].adv_queue < pages[next].adv_queue)
+        next = i;
+    }
+    if(next == -1)
+      break;
+    if(cur != -1 && !moved && refbit(&pages[cur], 0) && !refbit(&pages[next], 0)){
+      tmp = pages[cur].adv_queue;
+      pages[cur].adv_queue = pages[next].adv_queue;
+      pages[next].adv_queue = tmp;
+      moved = 1;        // cur is now in front of next
+      continue;
+    }
+    cur = next;
+    moved = 0;
+  }
+
+  for(i = 0; i < n; i++)
+    if(pages[i].state == USED)
+      refbit(&pages[i], 1);
+}
+
+// ARC, in its clock form (CAR, Bansal and Modha), since the kernel
+// only sees hits through the referenced bit.  Pages seen once are in
+// T1 and pages seen again are in T2, each a clock ordered by
+// create_order.  Ghost lists B1 and B2 remember pages recently swapped
+// out of T1 and T2; a fault on a ghost tells whether T1 should grow
+// (recency pays) or shrink (frequency pays).  Pages touched once by a
+// scan only ever pass through T1, so they cannot flush the pages kept
+// in T2.
+//
+// The faulting access itself sets the referenced bit of a new page, so
+// a page is ARC_FRESH until the next tick, which clears its bit; only
+// references after that count as "seen again" and move it to T2.  A
+// fault on a B2 ghost goes straight back to T2.  A fault on a B1 ghost
+// was only seen once while in memory, so it goes back to T1, but as
+// ARC_REUSED: T1 gives up pages new to it first, oldest first, and
+// only then reused ones, newest first.  So a loop over a few more
+// pages than fit keeps most of them in memory, where their next
+// reference takes them to T2, instead of evicting each page just
+// before its turn.
+
+// Pages not admitted by ARC (e.g. before a switch to ARC) count as T1.
+static int
+arc_in(struct page_struct *pg, int list)
+{
+  if(list == ARC_T2)
+    return (pg->arc_list & ARC_T2) != 0;
+  return (pg->arc_list & ARC_T2) == 0;
+}
+
+static int
+arc_count(struct page_struct *pages, int n, int list)
+{
+  int i, c = 0;
+
+  for(i = 0; i < n; i++)
+    if(pages[i].state == USED && arc_in(&pages[i], list))
+      c++;
+  return c;
+}
+
+// The oldest usable page of list, or -1.
+static int
+arc_head(struct page_struct *pages, int n, int list)
+{
+  int i, h = -1;
+
+  for(i = 0; i < n; i++){
+    if(!PP_USABLE(&pages[i]) || !arc_in(&pages[i], list))
+      continue;
+    if(h == -1 || pages[i].create_order < pages[h].create_order)
+      h = i;
+  }
+  return h;
+}
+
+// The page T1 gives up next: the oldest one new to it, or else
+// the newest reused one.  -1 if T1 has no usable page.
+static int
+arc_t1_victim(struct page_struct *pages, int n)
+{
+  int i, h = -1, r = -1;
+
+  for(i = 0; i < n; i++){
+    if(!PP_USABLE(&pages[i]) || !arc_in(&pages[i], ARC_T1))
+      continue;
+    if(pages[i].arc_list & ARC_REUSED){
+      if(r == -1 || pages[i].create_order > pages[r].create_order)
+        r = i;
+    } else if(h == -1 || pages[i].create_order < pages[h].create_order)
+      h = i;
+  }
+  return h >= 0 ? h : r;
+}
+
+static void
+ghost_drop(uint *b, int *nb, int i)
+{
+  for(; i + 1 < *nb; i++)
+    b[i] = b[i+1];
+  (*nb)--;
+}
+
+// Remember va, and the n pages swapped out before it (n+1 in all,
+// so a loop over twice the frames still hits its ghosts).
+static void
+ghost_push(uint *b, int *nb, uint va, int n)
+{
+  if(*nb >= n + 1 || *nb == ARC_GHOSTS)
+    ghost_drop(b, nb, 0);
+  b[(*nb)++] = va;
+}
+
+static int
+ghost_find(uint *b, int nb, uint va)
+{
+  int i;
+
+  for(i = 0; i < nb; i++)
+    if(b[i] == va)
+      return i;
+  return -1;
+}
+
+int
+pp_victim_ARC(struct page_struct *pages, int n, struct arc_state *s, refbit_fn refbit, uint *order)
+{
+  int t1, h1, h2, h, tries;
+
+  for(tries = 0; ; tries++){
+    t1 = arc_count(pages, n, ARC_T1);
+    h1 = arc_t1_victim(pages, n);
+    h2 = arc_head(pages, n, ARC_T2);
+    if(h1 >= 0 && (t1 >= (s->target > 1 ? s->target : 1) || h2 < 0))
+      h = h1;
+    else
+      h = h2;
+    if(h < 0)
+      return -1;
+
+    // Every page gets its bit cleared within two rounds.
+    if(!refbit(&pages[h], 1) || tries > 2 * n){
+      if(arc_in(&pages[h], ARC_T1))
+        ghost_push(s->b1, &s->nb1, pages[h].vAddr, n);
+      else
+        ghost_push(s->b2, &s->nb2, pages[h].vAddr, n);
+      return h;
+    }
+    // Only the fault that brought it in: once more round T1.
+    // Referenced again: to the back of T2.
+    if(pages[h].arc_list & ARC_FRESH)
+      pages[h].arc_list &= ~ARC_FRESH;
+    else
+      pages[h].arc_list = ARC_T2;
+    pages[h].create_order = (*order)++;
+  }
+}
+
+// pages[index] just came into memory.
+void
+pp_admit_ARC(struct page_struct *pages, int n, int index, struct arc_state *s, uint *order)
+{
+  uint va = pages[index].vAddr;
+  int c = n < ARC_GHOSTS ? n : ARC_GHOSTS;
+  int i, d;
+
+  if((i = ghost_find(s->b1, s->nb1, va)) >= 0){
+    // Recency would have kept it: grow T1.
+    d = s->nb1 >= s->nb2 ? 1 : s->nb2 / s->nb1;
+    s->target = s->target + d < c ? s->target + d : c;
+    ghost_drop(s->b1, &s->nb1, i);
+    pages[index].arc_list = ARC_T1 | ARC_REUSED;
+  } else if((i = ghost_find(s->b2, s->nb2, va)) >= 0){
+    // Frequency would have kept it: shrink T1.
+    d = s->nb2 >= s->nb1 ? 1 : s->nb1 / s->nb2;
+    s->target = s->target - d > 0 ? s->target - d : 0;
+    ghost_drop(s->b2, &s->nb2, i);
+    pages[index].arc_list = ARC_T2;
+  } else
+    pages[index].arc_list = ARC_T1;
+  pages[index].arc_list |= ARC_FRESH;
+  pages[index].create_order = (*order)++;
+}
+
+// Clock tick: forget the references that brought fresh pages in.
+void
+pp_tick_ARC(struct page_struct *pages, int n, refbit_fn refbit)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(pages[i].state == USED && (pages[i].arc_list & ARC_FRESH)){
+      refbit(&pages[i], 1);
+      pages[i].arc_list &= ~ARC_FRESH;
+    }
+  }
+}
@@ -0,0 +1,20 @@
+// Page replacement algorithms, shared by the kernel (vm.c) and the
+// host-side simulator (pagesim.c).  They only look at an array of
+// struct page_struct (see proc.h); whether a page was referenced since
+// the last look (its PTE_A bit, in the kernel) is asked through a
+// refbit callback, which clears the bit if clear is set.
+
+typedef int (*refbit_fn)(struct page_struct *page, int clear);
+
+#define PP_USABLE(pg) ((pg)->state == USED && !(pg)->pinned)
+
+int  pp_victim_NFUA(struct page_struct *pages, int n);
+int  pp_victim_LAPA(struct page_struct *pages, int n);
+int  pp_victim_SCFIFO(struct page_struct *pages, int n, refbit_fn refbit, uint *order);
+int  pp_victim_AQ(struct page_struct *pages, int n);
+void pp_age(struct page_struct *pages, int n, refbit_fn refbit);
+void pp_advance(struct page_struct *pages, int n, refbit_fn refbit);
+int  pp_victim_ARC(struct page_struct *pages, int n, struct arc_state *s, refbit_fn refbit, uint *order);
+void pp_admit_ARC(struct page_struct *pages, int n, int index, struct arc_state *s, uint *order);
+void pp_tick_ARC(struct page_struct *pages, int n, refbit_fn refbit);
+uint pp_popcount(uint x);
@@ -0,0 +1,374 @@
+// Page replacement simulator.
+//
+// Replays page reference traces against the kernel's replacement
+// policies (pagepolicy.c, built natively here the way mkfs is) and
+// against Belady's OPT, and prints the fault rate of each:
+//
+//   pagesim [-n frames | -n lo-hi[:step]] [-t refs-per-tick] [-s seed] trace...
+//
+// A trace is one of
+//   seq:PAGES:LEN       scan PAGES pages in order, LEN/PAGES refs in a row each
+//   loop:PAGES:LEN      cycle through PAGES pages, LEN refs in all
+//   rand:PAGES:LEN      LEN uniformly random refs to PAGES pages
+//   zipf:PAGES:LEN[:S]  LEN refs to PAGES pages, page k with weight 1/(k+1)^S
+//   FILE                a recorded trace, one address per line (decimal
+//                       or 0x hex); address/PGSIZE is the page
+//
+// Every miss counts as a fault, including the first touch of a page.
+// Clock ticks (aging for NFUA and LAPA, advancing for AQ, ending the
+// first reference for ARC) happen every -t references.  Frame counts
+// are limited to ARC_GHOSTS, the size of ARC's ghost lists.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "types.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "policy.h"
+#include "pagepolicy.h"
+
+#define POLICY_OPT NPOLICY    // Belady's OPT, only in the simulator
+
+struct trace {
+  char *name;
+  uint *ref;                  // dense page numbers 0..npages-1
+  int len;
+  int npages;
+  int *next;                  // next[i]: index of the next ref to ref[i]'s page
+};
+
+// Simulated memory of one run.
+struct sim {
+  struct page_struct *pages;  // the frames
+  char *refbit;               // PTE_A of each frame
+  int *frameof;               // page -> frame, or -1
+  char *seen;                 // page was in memory before
+  int *nextuse;               // OPT: next reference to each frame's page
+  uint order;                 // SCFIFO queue positions
+  int adv;                    // AQ queue positions
+  struct arc_state arc;
+};
+
+static struct sim *cur;
+static uint seed = 1;
+
+static char *names[] = {
+[POLICY_NFUA]   "NFUA",
+[POLICY_LAPA]   "LAPA",
+[POLICY_SCFIFO] "SCFIFO",
+[POLICY_AQ]     "AQ",
+[POLICY_ARC]    "ARC",
+[POLICY_OPT]    "OPT",
+};
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: pagesim [-n frames | -n lo-hi[:step]] [-t refs-per-tick] "
+          "[-s seed] trace...\n");
+  exit(1);
+}
+
+static void*
+xmalloc(size_t n)
+{
+  void *p;
+
+  if((p = calloc(1, n ? n : 1)) == 0){
+    perror("pagesim");
+    exit(1);
+  }
+  return p;
+}
+
+static uint
+rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static int
+refbit(struct page_struct *page, int clear)
+{
+  int i = page - cur->pages;
+  int r = cur->refbit[i];
+
+  if(clear)
+    cur->refbit[i] = 0;
+  return r;
+}
+
+// Renumber the pages of a recorded trace 0..npages-1.
+static void
+densify(struct trace *t)
+{
+  uint *key, h;
+  int *val, size, i, j;
+
+  for(size = 1; size < 2 * t->len; size <<= 1)
+    ;
+  key = xmalloc(size * sizeof(uint));
+  val = xmalloc(size * sizeof(int));
+  for(i = 0; i < size; i++)
+    val[i] = -1;
+  t->npages = 0;
+  for(i = 0; i < t->len; i++){
+    h = t->ref[i] * 2654435761u;
+    for(j = h & (size - 1); val[j] >= 0 && key[j] != t->ref[i]; j = (j + 1) & (size - 1))
+      ;
+    if(val[j] < 0){
+      key[j] = t->ref[i];
+      val[j] = t->npages++;
+    }
+    t->ref[i] = val[j];
+  }
+  free(key);
+  free(val);
+}
+
+static void
+readtrace(struct trace *t, char *file)
+{
+  FILE *f;
+  char line[128];
+  int cap = 1024;
+
+  if((f = fopen(file, "r")) == 0){
+    perror(file);
+    exit(1);
+  }
+  t->ref = xmalloc(cap * sizeof(uint));
+  while(fgets(line, sizeof(line), f)){
+    if(line[0] == '#' || line[0] == '\n')
+      continue;
+    if(t->len == cap){
+      cap *= 2;
+      if((t->ref = realloc(t->ref, cap * sizeof(uint))) == 0){
+        perror("pagesim");
+        exit(1);
+      }
+    }
+    t->ref[t->len++] = strtoul(line, 0, 0) / PGSIZE;
+  }
+  fclose(f);
+  densify(t);
+}
+
+static void
+maketrace(struct trace *t, char *spec)
+{
+  char kind[8];
+  int pages, len, i, lo, hi, mid;
+  double s = 1.0, *cdf, u;
+
+  t->name = spec;
+  if(sscanf(spec, "%7[a-z]:%d:%d:%lf", kind, &pages, &len, &s) < 3){
+    readtrace(t, spec);
+    return;
+  }
+  if(pages <= 0 || len <= 0)
+    usage();
+  t->len = len;
+  t->npages = pages;
+  t->ref = xmalloc(len * sizeof(uint));
+
+  if(strcmp(kind, "seq") == 0){
+    for(i = 0; i < len; i++)
+      t->ref[i] = (uint)((long long)i * pages / len);
+  } else if(strcmp(kind, "loop") == 0){
+    for(i = 0; i < len; i++)
+      t->ref[i] = i % pages;
+  } else if(strcmp(kind, "rand") == 0){
+    for(i = 0; i < len; i++)
+      t->ref[i] = rnd() % pages;
+  } else if(strcmp(kind, "zipf") == 0){
+    cdf = xmalloc(pages * sizeof(double));
+    for(i = 0; i < pages; i++)
+      cdf[i] = (i ? cdf[i-1] : 0) + 1.0 / pow(i + 1, s);
+    for(i = 0; i < len; i++){
+      u = (rnd() / 4294967296.0) * cdf[pages-1];
+      for(lo = 0, hi = pages - 1; lo < hi; ){
+        mid = (lo + hi) / 2;
+        if(cdf[mid] <= u)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      t->ref[i] = lo;
+    }
+    free(cdf);
+  } else
+    usage();
+  densify(t);
+}
+
+static void
+nextuses(struct trace *t)
+{
+  int *last, i;
+
+  t->next = xmalloc(t->len * sizeof(int));
+  last = xmalloc(t->npages * sizeof(int));
+  for(i = 0; i < t->npages; i++)
+    last[i] = t->len;
+  for(i = t->len - 1; i >= 0; i--){
+    t->next[i] = last[t->ref[i]];
+    last[t->ref[i]] = i;
+  }
+  free(last);
+}
+
+static int
+victim(struct sim *s, int policy, int n)
+{
+  int i, max;
+
+  switch(policy){
+  case POLICY_NFUA:
+    return pp_victim_NFUA(s->pages, n);
+  case POLICY_LAPA:
+    return pp_victim_LAPA(s->pages, n);
+  case POLICY_SCFIFO:
+    return pp_victim_SCFIFO(s->pages, n, refbit, &s->order);
+  case POLICY_AQ:
+    return pp_victim_AQ(s->pages, n);
+  case POLICY_ARC:
+    return pp_victim_ARC(s->pages, n, &s->arc, refbit, &s->order);
+  }
+  for(max = 0, i = 1; i < n; i++)
+    if(s->nextuse[i] > s->nextuse[max])
+      max = i;
+  return max;
+}
+
+static void
+tick(struct sim *s, int policy, int n)
+{
+  if(policy == POLICY_NFUA || policy == POLICY_LAPA)
+    pp_age(s->pages, n, refbit);
+  else if(policy == POLICY_AQ)
+    pp_advance(s->pages, n, refbit);
+  else if(policy == POLICY_ARC)
+    pp_tick_ARC(s->pages, n, refbit);
+}
+
+// Replay t with n frames under policy; return the number of faults.
+static int
+run(struct trace *t, int policy, int n, int tickrefs)
+{
+  struct sim s;
+  int i, f, used, faults;
+  uint pg;
+
+  memset(&s, 0, sizeof(s));
+  s.pages = xmalloc(n * sizeof(struct page_struct));
+  s.refbit = xmalloc(n);
+  s.nextuse = xmalloc(n * sizeof(int));
+  s.frameof = xmalloc(t->npages * sizeof(int));
+  s.seen = xmalloc(t->npages);
+  memset(s.frameof, 0xff, t->npages * sizeof(int));
+  cur = &s;
+
+  used = faults = 0;
+  for(i = 0; i < t->len; i++){
+    if(i > 0 && i % tickrefs == 0)
+      tick(&s, policy, n);
+    pg = t->ref[i];
+    if((f = s.frameof[pg]) >= 0){
+      s.refbit[f] = 1;
+      s.nextuse[f] = t->next[i];
+      continue;
+    }
+
+    faults++;
+    if(used < n)
+      f = used++;
+    else {
+      f = victim(&s, policy, n);
+      s.frameof[s.pages[f].vAddr] = -1;
+    }
+
+    // As add_page_to_ram() and page_in() do.
+    s.pages[f].state = USED;
+    s.pages[f].pinned = 0;
+    s.pages[f].arc_list = 0;
+    s.pages[f].vAddr = pg;
+    s.pages[f].create_order = s.order++;
+    s.pages[f].adv_queue = s.adv--;
+    s.pages[f].access_tracker = (policy == POLICY_LAPA && !s.seen[pg]) ? 0xFFFFFFFF : 0;
+    s.refbit[f] = 1;
+    s.nextuse[f] = t->next[i];
+    s.frameof[pg] = f;
+    s.seen[pg] = 1;
+    if(policy == POLICY_ARC)
+      pp_admit_ARC(s.pages, n, f, &s.arc, &s.order);
+  }
+
+  free(s.pages);
+  free(s.refbit);
+  free(s.nextuse);
+  free(s.frameof);
+  free(s.seen);
+  return faults;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct trace t;
+  int lo, hi, step, tickrefs, n, policy, i;
+
+  lo = hi = MAX_PSYC_PAGES;
+  step = 1;
+  tickrefs = 64;
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(i + 1 == argc)
+      usage();
+    if(strcmp(argv[i], "-n") == 0){
+      step = 1;
+      n = sscanf(argv[++i], "%d-%d:%d", &lo, &hi, &step);
+      if(n < 2)
+        hi = lo;
+      if(lo <= 0 || hi < lo || hi > ARC_GHOSTS || step <= 0)
+        usage();
+    } else if(strcmp(argv[i], "-t") == 0){
+      if((tickrefs = atoi(argv[++i])) <= 0)
+        usage();
+    } else if(strcmp(argv[i], "-s") == 0){
+      if((seed = strtoul(argv[++i], 0, 0)) == 0)
+        usage();
+    } else
+      usage();
+  }
+  if(i == argc)
+    usage();
+
+  for(; i < argc; i++){
+    memset(&t, 0, sizeof(t));
+    maketrace(&t, argv[i]);
+    nextuses(&t);
+    printf("%s: %d refs to %d pages, a tick every %d refs\n",
+           argv[i], t.len, t.npages, tickrefs);
+    printf("frames");
+    for(policy = POLICY_NFUA; policy <= POLICY_OPT; policy++)
+      printf(" %8s", names[policy]);
+    printf("\n");
+    for(n = lo; n <= hi; n += step){
+      printf("%6d", n);
+      for(policy = POLICY_NFUA; policy <= POLICY_OPT; policy++)
+        printf(" %7.2f%%", 100.0 * run(&t, policy, n, tickrefs) / t.len);
+      printf("\n");
+    }
+    printf("\n");
+    free(t.ref);
+    free(t.next);
+  }
+  return 0;
+}
@@ -1,4 +1,4 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC        64  // default maximum number of processes (nproc in proc.c)
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
@@ -10,5 +10,15 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define MAXPATH      128   // maximum file path name
+#define NHUGEPAGES      8  // 4 MB frames reserved for huge user pages
+#define NMADV           8  // madvise() ranges remembered per process
+#define NMMAP           8  // mmap()ed regions per process
+#define NPCACHE        64  // pages in the mmap() page cache
+#define NSWAPPOOL      8   // swap files kept for reuse after exit
+#define MAXSTACK       16  // max pages of a user stack (grown on demand)
 
+#define TICKHZ       100   // timer ticks per second
+#define NMLFQ          3   // scheduler priority levels (level i runs 1<<i ticks)
+#define MLFQBOOST    100   // ticks between moves of every process to level 0
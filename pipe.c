@@ -28,7 +28,7 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((p = (struct pipe*)kalloc()) == 0)
+  if((p = (struct pipe*)kmalloc(sizeof(*p))) == 0)
     goto bad;
   p->readopen = 1;
   p->writeopen = 1;
@@ -48,7 +48,7 @@ pipealloc(struct file **f0, struct file **f1)
 //PAGEBREAK: 20
  bad:
   if(p)
-    kfree((char*)p);
+    kmfree(p);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -69,7 +69,7 @@ pipeclose(struct pipe *p, int writable)
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
-    kfree((char*)p);
+    kmfree(p);
   } else
     release(&p->lock);
 }
@@ -87,12 +87,16 @@ pipewrite(struct pipe *p, char *addr, int n)
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
+      wakeupone(&p->nread);
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
     }
     p->data[p->nwrite++ % PIPESIZE] = addr[i];
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  // Readers and writers are woken one at a time; each passes the
+  // wakeup on to the next one of its kind while there is more for it.
+  wakeupone(&p->nread);  //DOC: pipewrite-wakeup1
+  if(p->nwrite < p->nread + PIPESIZE)
+    wakeupone(&p->nwrite);
   release(&p->lock);
   return n;
 }
@@ -115,7 +119,9 @@ piperead(struct pipe *p, char *addr, int n)
       break;
     addr[i] = p->data[p->nread++ % PIPESIZE];
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  wakeupone(&p->nwrite);  //DOC: piperead-wakeup
+  if(p->nread < p->nwrite)
+    wakeupone(&p->nread);
   release(&p->lock);
   return i;
 }
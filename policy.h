@@ -0,0 +1,7 @@
+#define POLICY_DEFAULT 0  // follow the system-wide default
+#define POLICY_NFUA    1  // not frequently used, with aging
+#define POLICY_LAPA    2  // least accessed page, with aging
+#define POLICY_SCFIFO  3  // second chance FIFO
+#define POLICY_AQ      4  // advancing queue
+#define POLICY_ARC     5  // adaptive replacement (clock-based, scan resistant)
+#define NPOLICY        6
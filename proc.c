@@ -4,26 +4,170 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
-
+#include "sleeplock.h"
+#include "policy.h"
+#include "trace.h"
+#include "vmstat.h"
+
+// A process slot: the proc and its paging locks, which are kept
+// out of struct proc so that proc.h needs no lock types (pagesim
+// includes it):
+//   pagemap: ram_manager and the replacement state, which the
+//            timer tick ages while the process runs elsewhere.
+//   swap:    the swap file and file_manager; held across the I/O.
+// Take swap before pagemap, and pagemap after ptable.lock.
+struct pslot {
+  struct proc proc;            // first, so a proc* is its pslot*
+  struct spinlock pagemap;
+  struct sleeplock swap;
+};
+
+// Slots are allocated as processes need them, up to nproc, and
+// are never freed: an UNUSED one goes on the free list, linked
+// through p->sibling, for the next allocproc().
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc **slot;          // the nslot slots allocated so far
+  int nslot;
+  struct proc *free;
 } ptable;
 
+// Maximum number of processes, chosen at boot by pinit().
+int nproc = NPROC;
+
 static struct proc *initproc;
 
+// Sleeping processes, hashed by channel, so that a wakeup only
+// looks at the sleepers on its own channel.  Each bucket lists
+// them in the order they went to sleep.  Guarded by ptable.lock.
+#define SQBITS 6
+static struct proc *sleepq[1<<SQBITS];
+
+// Live processes, hashed by pid.  Guarded by ptable.lock.
+#define PIDBITS 6
+static struct proc *pidhash[1<<PIDBITS];
+
+// Bumped by mlfqboost(): a level set before then counts as 0.
+static uint mlfqgen;
+static uint mlfqboosts;
+
+// For the vmstat device: paging counts of the processes reaped
+// by wait() (guarded by ptable.lock), and what the clock ticks
+// of the replacement policies cost.
+static uint exitfaults, exitpageouts;
+static uint policyticks, policycycles;
+
 int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void makerunnable(struct proc *p);
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  lockstat(&ptable.lock);
+
+  // The slot pointers must fit in the one page kmalloc() can give.
+  if(nproc < 1 || nproc > PGSIZE / sizeof(struct proc*))
+    nproc = NPROC;
+  if(sizeof(struct pslot) > PGSIZE)
+    panic("pinit: struct proc too big");
+  if((ptable.slot = kmalloc(nproc * sizeof(struct proc*))) == 0)
+    panic("pinit");
+}
+
+void
+lockpagemap(struct proc *p)
+{
+  acquire(&((struct pslot*)p)->pagemap);
+}
+
+void
+unlockpagemap(struct proc *p)
+{
+  release(&((struct pslot*)p)->pagemap);
+}
+
+void
+lockswap(struct proc *p)
+{
+  acquiresleep(&((struct pslot*)p)->swap);
+}
+
+void
+unlockswap(struct proc *p)
+{
+  releasesleep(&((struct pslot*)p)->swap);
+}
+
+static struct proc**
+pidbucket(int pid)
+{
+  return &pidhash[((uint)pid * 2654435761u) >> (32 - PIDBITS)];
+}
+
+// Look up the live process with the given pid.
+// The ptable lock must be held.
+static struct proc*
+pidlookup(int pid)
+{
+  struct proc *p;
+
+  for(p = *pidbucket(pid); p; p = p->pidnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+static void
+pidremove(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = pidbucket(p->pid); *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      *pp = p->pidnext;
+      p->pidnext = 0;
+      return;
+    }
+  }
+}
+
+// Take p out of the pid hash and put it back on the free list.
+// The ptable lock must be held.
+static void
+freeslot(struct proc *p)
+{
+  pidremove(p);
+  p->pid = 0;
+  p->state = UNUSED;
+  p->sibling = ptable.free;
+  ptable.free = p;
+}
+
+// A new UNUSED slot, or 0 if there are nproc of them already.
+// The ptable lock must be held.
+static struct proc*
+newslot(void)
+{
+  struct pslot *s;
+
+  if(ptable.nslot >= nproc || (s = kmalloc(sizeof(*s))) == 0)
+    return 0;
+  memset(s, 0, sizeof(*s));
+  initlock(&s->pagemap, "pagemap");
+  initsleeplock(&s->swap, "swap");
+  ptable.slot[ptable.nslot] = &s->proc;
+  // update_policies_for_all() reads the slots without the lock.
+  __sync_synchronize();
+  ptable.nslot++;
+  return &s->proc;
 }
 
 // Must be called with interrupts disabled
@@ -78,22 +222,31 @@ allocproc(void)
 
   acquire(&ptable.lock);
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-
-  release(&ptable.lock);
-  return 0;
+  if((p = ptable.free) != 0)
+    ptable.free = p->sibling;
+  else if((p = newslot()) == 0){
+    release(&ptable.lock);
+    return 0;
+  }
 
-found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->rqcpu = 0;
+  p->level = 0;
+  p->boostgen = mlfqgen;
+  p->ticksleft = 0;
+  p->children = 0;
+  p->sibling = 0;
+  p->pidnext = *pidbucket(p->pid);
+  *pidbucket(p->pid) = p;
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+  if((p->kstack = kmalloc(KSTACKSIZE)) == 0){
+    acquire(&ptable.lock);
+    freeslot(p);
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -107,10 +260,13 @@ found:
   p->paged_out_count = 0;
   p->create_order_counter = 0;
   p->adv_queue_counter = 0;
+  memset(p->madv, 0, sizeof(p->madv));
+  p->madv_next = 0;
+  p->scan_ptr = 0;
+  memset(p->mmaps, 0, sizeof(p->mmaps));
+  init_policy(p);
 
-  if(!is_shell_or_init(p))
-    createSwapFile(p);
-
+  p->swapFile = 0;
   init_swapfile(p);
 
   // Set up new context to start executing at forkret,
@@ -159,7 +315,7 @@ userinit(void)
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  makerunnable(p);
 
   release(&ptable.lock);
 }
@@ -173,6 +329,8 @@ growproc(int n)
   struct proc *curproc = myproc();
 
   sz = curproc->sz;
+  if(n > 0 && sz + n > HUGEBASE)
+    return -1;
   if(n > 0){
     if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
@@ -185,6 +343,28 @@ growproc(int n)
   return 0;
 }
 
+// Grow (or shrink) current process's huge-page region by n
+// bytes, rounded to 4 MB pages.  Return 0 on success, -1 on failure.
+int
+growhuge(int n)
+{
+  uint sz;
+  struct proc *curproc = myproc();
+
+  sz = curproc->hugesz;
+  if(n > 0){
+    if((sz = allochuge(curproc->pgdir, sz, sz + n)) == 0)
+      return -1;
+  } else if(n < 0){
+    if((uint)-n > sz)
+      return -1;
+    sz = deallochuge(curproc->pgdir, sz, sz + n);
+  }
+  curproc->hugesz = sz;
+  switchuvm(curproc);
+  return 0;
+}
+
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
@@ -202,27 +382,44 @@ fork(void)
 
   // Copy process state from proc.
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
+    kmfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    freeslot(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
+  np->hugesz = curproc->hugesz;
+  np->stacksz = curproc->stacksz;
+  memmove(np->madv, curproc->madv, sizeof(np->madv));
+  np->madv_next = curproc->madv_next;
+  np->scan_ptr = curproc->scan_ptr;
+  np->policy = curproc->policy;
+  np->curpolicy = curproc->curpolicy;
+  np->arc = curproc->arc;
 
   // Our Addition
   if (!is_shell_or_init(curproc)){
-    clone_file(curproc, np); // Inherit swapfile content from father(curproc) to son(np)
+    // Inherit swapfile content from father(curproc) to son(np)
+    if (clone_file(curproc, np) < 0)
+      goto bad;
+    lockpagemap(curproc);
     for (i = 0; i < MAX_PSYC_PAGES; i++){
       np->ram_manager[i] = curproc->ram_manager[i];
       np->ram_manager[i].pgdir = np->pgdir;
+      np->ram_manager[i].pinned = 0;   // locks are not inherited
     }
+    unlockpagemap(curproc);
     for (i = 0; i < MAX_FILE_PAGES; i++){
       np->file_manager[i] = curproc->file_manager[i];
       np->file_manager[i].pgdir = np->pgdir;
     }
   }
 
-  np->parent = curproc;
+  if(mmapfork(np, curproc) < 0)
+    goto bad;
+
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -238,10 +435,23 @@ fork(void)
   pid = np->pid;
 
   acquire(&ptable.lock);
-  np->state = RUNNABLE;
+  np->parent = curproc;
+  np->sibling = curproc->children;
+  curproc->children = np;
+  makerunnable(np);
   release(&ptable.lock);
 
   return pid;
+
+bad:
+  removeSwapFile(np);
+  freevm(np->pgdir);
+  kmfree(np->kstack);
+  np->kstack = 0;
+  acquire(&ptable.lock);
+  freeslot(np);
+  release(&ptable.lock);
+  return -1;
 }
 
 // Exit the current process.  Does not return.
@@ -257,8 +467,8 @@ exit(void)
   if(curproc == initproc)
     panic("init exiting");
 
+  mmapclose(curproc);
 
-  
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(curproc->ofile[fd]){
@@ -283,11 +493,15 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
-      p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
+  for(p = curproc->children; p; p = p->sibling){
+    p->parent = initproc;
+    if(p->state == ZOMBIE)
+      wakeup1(initproc);
+    if(p->sibling == 0){
+      p->sibling = initproc->children;
+      initproc->children = curproc->children;
+      curproc->children = 0;
+      break;
     }
   }
 
@@ -308,43 +522,55 @@ exit(void)
 int
 wait(void)
 {
-  struct proc *p;
-  int havekids, pid;
+  struct proc **pp, *p;
+  int pid;
+  pde_t *pgdir;
+  char *kstack;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through the children looking for exited ones.
+    for(pp = &curproc->children; (p = *pp) != 0; pp = &p->sibling){
       if(p->state == ZOMBIE){
         // Found one.
+        *pp = p->sibling;
         pid = p->pid;
-        kfree(p->kstack);
+        kstack = p->kstack;
         p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
+        pgdir = p->pgdir;
+        p->pgdir = 0;
+        exitfaults += p->page_fault_count;
+        exitpageouts += p->paged_out_count;
 
         // Our Addition
+        lockpagemap(p);
         for (int i = 0; i < MAX_PSYC_PAGES; i++)
           p->ram_manager[i].state = NOT_USED;
+        unlockpagemap(p);
         for (int i = 0; i < MAX_TOTAL_PAGES-MAX_PSYC_PAGES; i++)
           p->file_manager[i].state = NOT_USED;
 
         p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
-        p->state = UNUSED;
+        p->lastcpu = 0;
+        p->hugesz = 0;
+        p->stacksz = 0;
+        freeslot(p);
         release(&ptable.lock);
+
+        // Another CPU may still have the page table loaded;
+        // it can only let go of it while ptable.lock is free.
+        retirepgdir(pgdir);
+        freevm(pgdir);
+        kmfree(kstack);
         return pid;
       }
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
+    if(curproc->children == 0 || curproc->killed){
       release(&ptable.lock);
       return -1;
     }
@@ -354,11 +580,202 @@ wait(void)
   }
 }
 
+// Run queues.  Each CPU has its own queues of RUNNABLE processes,
+// so choosing the next one does not scan ptable.  A RUNNABLE
+// process is on exactly one queue.  The queues are guarded by
+// ptable.lock, which also guards p->state and is handed across
+// swtch(), but an idle CPU only takes that lock once some queue
+// has work: it looks at the (volatile) queue lengths without it,
+// and halts while they are all empty.
+//
+// The queues form a multilevel feedback queue.  A process starts
+// at level 0 and runs from the highest level with work.  Using up
+// the whole quantum of its level, 1<<level ticks, moves it down a
+// level; giving up the CPU earlier, as a process waiting on a
+// swap_in() or other disk I/O does, keeps it where it is.  Every
+// MLFQBOOST ticks mlfqboost() moves every process back to level 0,
+// so CPU-bound ones are not starved.
+
+static int
+plevel(struct proc *p)
+{
+  return p->boostgen == mlfqgen ? p->level : 0;
+}
+
+static void
+rqpush(struct cpu *c, struct proc *p)
+{
+  int l = plevel(p);
+
+  p->level = l;
+  p->boostgen = mlfqgen;
+  p->rqnext = 0;
+  if(c->rqtail[l])
+    c->rqtail[l]->rqnext = p;
+  else
+    c->rqhead[l] = p;
+  c->rqtail[l] = p;
+  c->rqlen++;
+}
+
+// Take the first process off the highest non-empty level.
+static struct proc*
+rqpop(struct cpu *c)
+{
+  struct proc *p;
+  int l;
+
+  for(l = 0; l < NMLFQ; l++)
+    if(c->rqhead[l])
+      break;
+  if(l == NMLFQ)
+    return 0;
+  p = c->rqhead[l];
+  c->rqhead[l] = p->rqnext;
+  if(c->rqhead[l] == 0)
+    c->rqtail[l] = 0;
+  c->rqlen--;
+  p->rqnext = 0;
+  return p;
+}
+
+// The CPU with the longest run queue, or 0 if all are empty.
+static struct cpu*
+rqbusiest(void)
+{
+  struct cpu *c, *busiest = 0;
+
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(c->rqlen > 0 && (busiest == 0 || c->rqlen > busiest->rqlen))
+      busiest = c;
+  return busiest;
+}
+
+// Wake CPU c with a reschedule IPI if it is halted in scheduler().
+void
+cpuwake(struct cpu *c)
+{
+  pushcli();
+  __sync_synchronize();   // pairs with the xchg in scheduler()
+  if(c->idle && c != mycpu())
+    lapicipi(c->apicid, T_IRQ0 + IRQ_RESCHED);
+  popcli();
+}
+
+// Mark p RUNNABLE and queue it on the CPU it last ran on, whose
+// caches and TLB may still hold its state, or else on this CPU.
+// If that CPU is busy, wake a halted one to steal p.
+// The ptable lock must be held.
+static void
+makerunnable(struct proc *p)
+{
+  struct cpu *c = p->rqcpu;
+
+  if(c == 0 || !c->started)
+    c = mycpu();
+  p->state = RUNNABLE;
+  rqpush(c, p);
+
+  __sync_synchronize();
+  if(!c->idle)
+    for(c = cpus; c < cpus+ncpu && !c->idle; c++)
+      ;
+  if(c < cpus+ncpu)
+    cpuwake(c);
+}
+
+// Move every process to level 0: append the lower queues of each
+// CPU to its level 0 queue, and start a new mlfqgen so that the
+// levels of the processes not queued read as 0 too.
+void
+mlfqboost(void)
+{
+  struct cpu *c;
+  int l;
+
+  acquire(&ptable.lock);
+  mlfqgen++;
+  mlfqboosts++;
+  for(c = cpus; c < cpus+ncpu; c++){
+    for(l = 1; l < NMLFQ; l++){
+      if(c->rqhead[l] == 0)
+        continue;
+      if(c->rqtail[0])
+        c->rqtail[0]->rqnext = c->rqhead[l];
+      else
+        c->rqhead[0] = c->rqhead[l];
+      c->rqtail[0] = c->rqtail[l];
+      c->rqhead[l] = c->rqtail[l] = 0;
+    }
+  }
+  release(&ptable.lock);
+}
+
+// Charge the current process for a timer tick.  Return 1 if it
+// should yield: it used up its quantum, and goes down a level, or
+// a process of a higher level is waiting on this CPU.
+int
+mlfqtick(void)
+{
+  struct cpu *c;
+  struct proc *p;
+  int l, preempt = 0;
+
+  pushcli();
+  c = mycpu();
+  p = c->proc;
+  l = plevel(p);
+  if(--p->ticksleft <= 0){
+    c->mlfqdemote[l]++;
+    p->level = l < NMLFQ-1 ? l+1 : l;
+    p->boostgen = mlfqgen;
+    p->ticksleft = 0;
+    preempt = 1;
+  }
+  while(!preempt && --l >= 0)
+    if(c->rqhead[l])
+      preempt = 1;
+  popcli();
+  return preempt;
+}
+
+static struct proc**
+sqbucket(void *chan)
+{
+  return &sleepq[((uint)chan * 2654435761u) >> (32 - SQBITS)];
+}
+
+static void
+sqadd(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = sqbucket(p->chan); *pp; pp = &(*pp)->sqnext)
+    ;
+  p->sqnext = 0;
+  *pp = p;
+}
+
+static void
+sqremove(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = sqbucket(p->chan); *pp; pp = &(*pp)->sqnext){
+    if(*pp == p){
+      *pp = p->sqnext;
+      p->sqnext = 0;
+      return;
+    }
+  }
+}
+
 //PAGEBREAK: 42
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run
+//  - choose a process to run: the head of this CPU's run
+//    queue, or else one stolen from the longest run queue
 //  - swtch to start running that process
 //  - eventually that process transfers control
 //      via swtch back to the scheduler.
@@ -367,27 +784,66 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  struct cpu *busiest;
   c->proc = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
+    if(c->dropcr3){
+      // A page table we kept loaded is being freed.
+      c->dropcr3 = 0;
+      switchkvm();
+      c->pgdir = 0;
+    }
+
+    // Nothing to run anywhere: halt until an interrupt, without
+    // touching ptable.lock.  The timer only comes for a sleep()
+    // deadline (see timeridle), and makerunnable() and
+    // retirepgdir() send a reschedule IPI.
+    // Being idle is announced before the last look at the queues,
+    // so either this CPU sees the new work or the waker sees it idle.
+    cli();
+    xchg(&c->idle, 1);
+    if(c->rqlen == 0 && rqbusiest() == 0 && !c->dropcr3){
+      timeridle();
+      stihlt();
+      c->idle = 0;
+      continue;
+    }
+    c->idle = 0;
+    timerbusy();
+
     acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    p = rqpop(c);
+    if(p == 0 && (busiest = rqbusiest()) != 0)
+      p = rqpop(busiest);
+    if(p != 0){
       if(p->state != RUNNABLE)
-        continue;
+        panic("scheduler: queued process not runnable");
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
       c->proc = p;
-      switchuvm(p);
+      p->rqcpu = c;
+      c->mlfqruns[plevel(p)]++;
+      if(p->ticksleft <= 0)
+        p->ticksleft = 1 << plevel(p);
+      resumeuvm(p);
       p->state = RUNNING;
+      trace(TR_SWITCH, p, plevel(p), 0);
 
       swtch(&(c->scheduler), p->context);
-      switchkvm();
+
+      // Stay on p's page table: its kernel half is the same as
+      // kpgdir's, and if p runs here next no flush is needed.
+      // A zombie's page table is about to be freed, though.
+      if(p->state == ZOMBIE){
+        switchkvm();
+        c->pgdir = 0;
+      }
 
       // Process is done running for now.
       // It should have changed its p->state before coming back.
@@ -429,7 +885,7 @@ void
 yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  makerunnable(myproc());
   sched();
   release(&ptable.lock);
 }
@@ -450,6 +906,7 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    cleanSwapFiles();
   }
 
   // Return to "caller", actually trapret (see allocproc).
@@ -481,6 +938,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  sqadd(p);
 
   sched();
 
@@ -495,16 +953,35 @@ sleep(void *chan, struct spinlock *lk)
 }
 
 //PAGEBREAK!
+// Wake up the processes sleeping on chan: all of them, or
+// just the one that has slept longest.
+// The ptable lock must be held.
+static void
+wakechan(void *chan, int all)
+{
+  struct proc **pp, *p;
+
+  pp = sqbucket(chan);
+  while((p = *pp) != 0){
+    if(p->chan != chan){
+      pp = &p->sqnext;
+      continue;
+    }
+    *pp = p->sqnext;
+    p->sqnext = 0;
+    p->ticksleft = 0;
+    makerunnable(p);
+    if(!all)
+      return;
+  }
+}
+
 // Wake up all processes sleeping on chan.
 // The ptable lock must be held.
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+  wakechan(chan, 1);
 }
 
 // Wake up all processes sleeping on chan.
@@ -516,6 +993,17 @@ wakeup(void *chan)
   release(&ptable.lock);
 }
 
+// Wake up one process sleeping on chan, for channels where
+// whoever wakes takes the resource and the rest would only
+// go back to sleep.
+void
+wakeupone(void *chan)
+{
+  acquire(&ptable.lock);
+  wakechan(chan, 0);
+  release(&ptable.lock);
+}
+
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
@@ -525,15 +1013,15 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
+  if((p = pidlookup(pid)) != 0){
+    p->killed = 1;
+    // Wake process from sleep if necessary.
+    if(p->state == SLEEPING){
+      sqremove(p);
+      makerunnable(p);
     }
+    release(&ptable.lock);
+    return 0;
   }
   release(&ptable.lock);
   return -1;
@@ -554,14 +1042,15 @@ procdump(void)
   [RUNNING]   "run   ",
   [ZOMBIE]    "zombie"
   };
-  int i;
+  int i, n;
   struct proc *p;
   char *state;
   uint pc[10];
   
   
   cprintf("\n");
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(n = 0; n < ptable.nslot; n++){
+    p = ptable.slot[n];
     int allocatedPages = PGROUNDUP(p->sz)/PGSIZE;
     if(p->state == UNUSED)
       continue;
@@ -571,7 +1060,7 @@ procdump(void)
       state = "???";
 
 
-    cprintf("%d %s %d %d %d %d %s", p->pid, state, allocatedPages, getNumOfPagesInFile(p), p->page_fault_count, p->paged_out_count, p->name);
+    cprintf("%d %s %d %d %d %d %s L%d", p->pid, state, allocatedPages, getNumOfPagesInFile(p), p->page_fault_count, p->paged_out_count, p->name, plevel(p));
     
     if(p->state == SLEEPING){
       getcallerpcs((uint*)p->context->ebp+2, pc);
@@ -581,11 +1070,27 @@ procdump(void)
     cprintf("\n");
   }
 
+  // Scheduler levels: processes queued, dispatched, and demoted for
+  // using a whole quantum, summed over the CPUs.
+  for(i = 0; i < NMLFQ; i++){
+    int queued = 0, runs = 0, demoted = 0;
+    struct cpu *c;
+    for(c = cpus; c < cpus+ncpu; c++){
+      for(p = c->rqhead[i]; p; p = p->rqnext)
+        queued++;
+      runs += c->mlfqruns[i];
+      demoted += c->mlfqdemote[i];
+    }
+    cprintf("Level %d (%d ticks): %d queued, %d runs, %d demoted\n", i, 1 << i, queued, runs, demoted);
+  }
+  cprintf("Boosts to level 0: %d\n", mlfqboosts);
+
   int freePages = getFreePages();
   int TotalPages = getTotalPages();
   cprintf("Used pages in the system: %d\n", TotalPages - freePages);
   cprintf("Free pages in the system: %d/%d", freePages, TotalPages);
   cprintf("\n");
+  cprintf("Free huge pages in the system: %d/%d\n", getFreeHugePages(), NHUGEPAGES);
 }
 
 
@@ -622,35 +1127,110 @@ is_shell_or_init(struct proc* p){
   return pid <= 2;
 }
 
+/*
+* Runs the clock tick hook of the replacement policy of every paging process,
+* so only the hooks of policies in use run
+*/
 void
-update_access_trackers_for_all(void){
+update_policies_for_all(void){
 
   struct proc *p;
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    // if (!is_shell_or_init(p) && (p->state == RUNNING ||
-    //                           p->state == RUNNABLE ||
-    //                           p->state == SLEEPING)){
-    if(p->pid > 2 && p->state > 1 && p->state < 5){
-      update_access_trackers(p); //implemented in vm.c
+  struct page_policy *policy;
+  unsigned long long t0;
+  int i;
+
+  if(check_NONE_policy())
+    return;
+  t0 = rdtsc();
+
+  // Each process is aged under its own pagemap lock, so neither
+  // ptable.lock nor the paging of other processes holds this up.
+  // wait() clears a zombie's ram_manager under that lock too.
+  // Slots are never freed, so they can be walked without ptable.lock.
+  for(i = 0; i < ptable.nslot; i++){
+    p = ptable.slot[i];
+    lockpagemap(p);
+    if (!is_shell_or_init(p) && (p->state == RUNNING ||
+                              p->state == RUNNABLE ||
+                              p->state == SLEEPING)){
+
+      policy = proc_policy(p);
+      if(policy->on_tick)
+        policy->on_tick(p); //implemented in vm.c
     }
+    unlockpagemap(p);
   }
-  release(&ptable.lock);
+
+  // Ticks may run on two CPUs at once (see timer.c)
+  __sync_fetch_and_add(&policyticks, 1);
+  __sync_fetch_and_add(&policycycles, (uint)(rdtsc() - t0));
 }
 
+/*
+* Restarts the policy of the paging processes that follow the
+* default one, which setpolicy() just changed (see restart_policy).
+* restart_policy() rechecks p->policy under the pagemap lock.
+*/
 void
-update_adv_queues_for_all(void){
+restart_default_policy(void){
 
   struct proc *p;
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if (!is_shell_or_init(p) && (p->state == RUNNING ||
-                              p->state == RUNNABLE ||
-                              p->state == SLEEPING)){
+  int i;
+
+  // Walked without ptable.lock, like update_policies_for_all().
+  for(i = 0; i < ptable.nslot; i++){
+    p = ptable.slot[i];
+    if (p->policy == POLICY_DEFAULT && !is_shell_or_init(p) &&
+        (p->state == RUNNING || p->state == RUNNABLE || p->state == SLEEPING)){
+      lockpagemap(p);
+      restart_policy(p);
+      unlockpagemap(p);
+    }
+  }
+}
+
+/*
+* Fills the process part of a vmstat device read: totals in st, and up to n
+* processes in vp (st->nproc of them)
+*/
+void
+procvmstat(struct vmstat *st, struct vmproc *vp, int n)
+{
+  struct proc *p;
+  int i;
 
-      update_adv_queues(p); //implemented in vm.c
+  acquire(&ptable.lock);
+  st->faults = exitfaults;
+  st->pageouts = exitpageouts;
+  st->swapused = st->swapslots = 0;
+  st->nproc = 0;
+  for(i = 0; i < ptable.nslot; i++){
+    p = ptable.slot[i];
+    if(p->state == UNUSED)
+      continue;
+    st->faults += p->page_fault_count;
+    st->pageouts += p->paged_out_count;
+    if(p->swapFile){
+      st->swapused += getNumOfPagesInFile(p);
+      st->swapslots += MAX_FILE_PAGES;
     }
+    if(st->nproc == n)
+      continue;
+    vp->pid = p->pid;
+    safestrcpy(vp->name, p->name, sizeof(vp->name));
+    vp->policy = p->policy;
+    vp->size = PGROUNDUP(p->sz)/PGSIZE;
+    lockpagemap(p);
+    vp->resident = getNumOfPagesInMem(p);
+    unlockpagemap(p);
+    vp->swapped = getNumOfPagesInFile(p);
+    vp->faults = p->page_fault_count;
+    vp->pageouts = p->paged_out_count;
+    vp++;
+    st->nproc++;
   }
+  st->policyticks = policyticks;
+  st->policycycles = policycycles;
   release(&ptable.lock);
 }
 
@@ -2,6 +2,9 @@
 #define MAX_PSYC_PAGES 16
 #define MAX_TOTAL_PAGES 32
 #define MAX_FILE_PAGES (MAX_TOTAL_PAGES - MAX_PSYC_PAGES)
+#define MAX_LOCKED_PAGES (MAX_PSYC_PAGES / 2)
+#define MAX_IO_PAGES (MAX_PSYC_PAGES / 4)
+#define SWAP_BATCH (MAX_PSYC_PAGES / 4)
 
 
 // Per-CPU state
@@ -14,6 +17,15 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  pde_t * volatile pgdir;      // User page table in %cr3, 0 if kpgdir
+  volatile int dropcr3;        // Asked to stop using pgdir (see retirepgdir)
+  struct proc *rqhead[NMLFQ];  // Run queues, one per level: RUNNABLE processes to run here
+  struct proc *rqtail[NMLFQ];
+  volatile int rqlen;          // Number of processes in all the run queues
+  uint mlfqruns[NMLFQ];        // Processes dispatched from each level
+  uint mlfqdemote[NMLFQ];      // Processes that used a whole quantum at each level
+  volatile uint idle;          // Halted in scheduler() for lack of work
+  volatile uint ticking;       // Timer armed every tick (see timer.c)
 };
 
 extern struct cpu cpus[NCPU];
@@ -49,8 +61,57 @@ struct page_struct {
   uint access_tracker;
   uint create_order;
   int adv_queue; // tracks the place in advance queue
+  int cached;    // maps a page cache page (mmap.c), so it is unmapped rather than swapped out
+  int pinned;    // PIN_MLOCK and/or PIN_IO: never picked for swapping out
+  int arc_list;  // ARC: ARC_T1 (seen once, maybe ARC_REUSED) or ARC_T2 (seen again), ARC_FRESH while in its first tick
 };
 
+#define PIN_MLOCK 0x1   // by mlock()
+#define PIN_IO    0x2   // as a system call buffer, until the call returns (see iopin)
+
+#define ARC_T1    0x1
+#define ARC_T2    0x2
+#define ARC_FRESH 0x4
+#define ARC_REUSED 0x8  // in ARC_T1 again after a fault on its B1 ghost
+
+#ifndef ARC_GHOSTS
+#define ARC_GHOSTS (MAX_PSYC_PAGES + 1)
+#endif
+
+// ARC history: where to aim, and ghosts of recently swapped-out pages
+struct arc_state {
+  int target;                  // wanted number of ARC_T1 pages
+  int nb1, nb2;
+  uint b1[ARC_GHOSTS];         // vAddrs swapped out of ARC_T1, oldest first
+  uint b2[ARC_GHOSTS];         // vAddrs swapped out of ARC_T2, oldest first
+};
+
+// A page replacement policy (the table is in vm.c)
+struct page_policy {
+  char *name;
+  int (*pick_victim)(struct proc* p);            // ram_manager index of the page to swap out
+  void (*on_tick)(struct proc* p);               // every clock tick, may be 0
+  void (*on_insert)(struct proc* p, int index);  // ram_manager[index] was just added, may be 0
+  void (*on_fault)(struct proc* p, int index);   // ram_manager[index] was just swapped in, may be 0
+};
+
+
+// An madvise() hint for the user pages start..end
+struct madv_range {
+  uint start;
+  uint end;
+  int advice;                  // MADV_* from madvise.h
+};
+
+// A file mapped by mmap() at start..end
+struct vma {
+  uint start;                  // 0 if the slot is free
+  uint end;
+  uint off;                    // file offset mapped at start
+  int prot;                    // PROT_* from mman.h
+  int flags;                   // MAP_SHARED or MAP_PRIVATE
+  struct file *f;
+};
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
@@ -62,16 +123,33 @@ struct proc {
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
+  struct proc *children;       // First child, or 0
+  struct proc *sibling;        // Next child of parent (next free slot if UNUSED)
+  struct proc *pidnext;        // Next process in pid's hash bucket
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
+  struct proc *sqnext;         // Next sleeper in chan's hash bucket
   int killed;                  // If non-zero, have been killed
+  int nsleeplock;              // Sleeplocks held (see trap.c)
+  int logop;                   // Inside begin_op() (see trap.c)
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct cpu *lastcpu;         // CPU whose TLB may still hold our mappings
+  struct cpu *rqcpu;           // CPU it last ran on, whose run queue it joins
+  struct proc *rqnext;         // Next in that run queue
+  int level;                   // Scheduler level, 0 runs first (see plevel)
+  uint boostgen;               // Value of mlfqgen when level was set
+  int ticksleft;               // Timer ticks left of the quantum, 0 to refill
+  uint wakeat;                 // In sleep(): tick to wake up at
+  struct proc *tnext;          // Next in wakeat's timer wheel bucket
+  uint hugesz;                 // Bytes of 4 MB pages mapped at HUGEBASE
+  uint stacksz;                // Bytes of user stack mapped below STACKTOP
 
-  //Swap file. must initiate with create swap file
+  //Swap file. created by the first page_out (see createSwapFile)
   struct file *swapFile;      //page file
+  int swapid;                 //swap file is /.swap<swapid>
 
   struct page_struct file_manager[MAX_FILE_PAGES];
   struct page_struct ram_manager[MAX_PSYC_PAGES];
@@ -79,6 +157,13 @@ struct proc {
   uint page_fault_count;      // counts the general number of page fault times. page fault occurs when seeked page doesnt exist in the ram so we need to look for it in the file
   uint create_order_counter;  // manages the creation number for the SCFIFO policy (every new page gets a new number which represents its place in queue)
   int adv_queue_counter;      // manages the place number for the queue in AQ policy (every new page gets a new number which represents its place in queue)
+  struct madv_range madv[NMADV]; // madvise() hints, newest at madv_next-1
+  int madv_next;
+  uint scan_ptr;              // last faulting address (for MADV_SEQUENTIAL)
+  struct vma mmaps[NMMAP];    // mmap()ed files
+  int policy;                 // POLICY_* from policy.h, POLICY_DEFAULT follows default_policy
+  int curpolicy;              // POLICY_* in use, whose bookkeeping the pages hold (see restart_policy)
+  struct arc_state arc;       // history of the ARC policy
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -0,0 +1,108 @@
+// Kernel sampling profiler.
+//
+// While it is on, every timer interrupt records where the CPU was
+// into that CPU's ring of samples; prof(PROF_DRAIN) takes them out.
+// A CPU only takes timer interrupts while it runs processes (see
+// timer.c), so idle time is not sampled, and code running with
+// interrupts off is charged to where it turns them back on.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "prof.h"
+
+#define NPROFBUF 2048  // samples per CPU
+
+static struct {
+  struct spinlock lock;
+  struct profsample buf[NPROFBUF];
+  uint r, w;           // samples read and written, w-r are in buf
+  uint lost;           // samples dropped because buf was full
+} prof[NCPU];
+
+static int profon;
+
+void
+profinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    initlock(&prof[i].lock, "prof");
+}
+
+// Record a sample of this CPU at the trap tf.
+// Interrupts must be off.
+void
+profsample(struct trapframe *tf)
+{
+  struct profsample *s;
+  struct cpu *c;
+  int i;
+
+  if(!profon)
+    return;
+  c = mycpu();
+  i = c - cpus;
+  acquire(&prof[i].lock);
+  if(prof[i].w - prof[i].r == NPROFBUF)
+    prof[i].lost++;
+  else {
+    s = &prof[i].buf[prof[i].w++ % NPROFBUF];
+    s->eip = tf->eip;
+    s->pid = c->proc ? c->proc->pid : 0;
+    s->user = (tf->cs&3) == DPL_USER;
+  }
+  release(&prof[i].lock);
+}
+
+// Start or stop the profiler, or drain up to n samples to st.
+int
+profctl(int cmd, struct profsample *st, int n)
+{
+  struct profsample s;
+  int i, got, lost;
+
+  switch(cmd){
+  case PROF_START:
+    for(i = 0; i < ncpu; i++){
+      acquire(&prof[i].lock);
+      prof[i].r = prof[i].w = prof[i].lost = 0;
+      release(&prof[i].lock);
+    }
+    profon = 1;
+    return 0;
+
+  case PROF_STOP:
+    profon = 0;
+    lost = 0;
+    for(i = 0; i < ncpu; i++){
+      acquire(&prof[i].lock);
+      lost += prof[i].lost;
+      release(&prof[i].lock);
+    }
+    return lost;
+
+  case PROF_DRAIN:
+    // One sample at a time: writing st may fault, which
+    // must not happen holding a spinlock.
+    got = 0;
+    for(i = 0; i < ncpu && got < n; ){
+      acquire(&prof[i].lock);
+      if(prof[i].r == prof[i].w){
+        release(&prof[i].lock);
+        i++;
+        continue;
+      }
+      s = prof[i].buf[prof[i].r++ % NPROFBUF];
+      release(&prof[i].lock);
+      st[got++] = s;
+    }
+    return got;
+  }
+  return -1;
+}
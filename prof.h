@@ -0,0 +1,11 @@
+// Kernel sampling profiler (see prof.c), driven with prof().
+#define PROF_START 1   // drop old samples and start sampling
+#define PROF_STOP  2   // stop sampling; returns how many samples were lost
+#define PROF_DRAIN 3   // move up to n samples to the buffer; returns how many
+
+// Where a CPU was at a timer interrupt
+struct profsample {
+  uint eip;
+  int pid;             // running process, 0 if none (scheduler)
+  int user;            // 1 if in user mode
+};
@@ -28,6 +28,7 @@ acquiresleep(struct sleeplock *lk)
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  myproc()->nsleeplock++;
   release(&lk->lk);
 }
 
@@ -37,7 +38,8 @@ releasesleep(struct sleeplock *lk)
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  myproc()->nsleeplock--;
+  wakeupone(lk);  // only one of the waiters can take it
   release(&lk->lk);
 }
 
@@ -8,29 +8,61 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
+
+// Statistics of the locks passed to lockstat().
+static struct {
+  struct spinlock *lock[NLOCKSTAT];
+  struct lockstat stat[NLOCKSTAT];
+  int n;
+} lockstats;
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->stat = 0;
+  lk->spin = 0;
+}
+
+// Keep statistics of lk, for getlockstat().
+// Call it at boot, right after initlock().
+void
+lockstat(struct spinlock *lk)
+{
+  if(lockstats.n == NLOCKSTAT)
+    panic("lockstat");
+  lockstats.lock[lockstats.n] = lk;
+  lk->stat = &lockstats.stat[lockstats.n++];
 }
 
 // Acquire the lock.
-// Loops (spins) until the lock is acquired.
+// Takes a ticket and loops (spins) until it is served.
+// Waiters only read the lock while they spin, so the line holding
+// it bounces between CPUs once per handoff, not once per attempt.
 // Holding a lock for a long time may cause
 // other CPUs to waste time spinning to acquire it.
 void
 acquire(struct spinlock *lk)
 {
+  uint me;
+  unsigned long long t0 = 0;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // The fetch-and-add is atomic.
+  me = __sync_fetch_and_add(&lk->next, 1);
+  if(*(volatile uint*)&lk->owner != me){
+    if(lk->stat)
+      t0 = rdtsc();
+    while(*(volatile uint*)&lk->owner != me)
+      asm volatile("pause");
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -39,17 +71,42 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for debugging.
   lk->cpu = mycpu();
+#ifdef LOCKDEBUG
   getcallerpcs(&lk, lk->pcs);
+#endif
+
+  if(lk->stat){
+    lk->tacquire = rdtsc();
+    lk->stat->acquires++;
+    if(t0){
+      lk->stat->contended++;
+      lk->spin += lk->tacquire - t0;
+    }
+  }
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  unsigned long long t;
+  uint h;
+  int b;
+
   if(!holding(lk))
     panic("release");
 
+  if(lk->stat){
+    t = rdtsc() - lk->tacquire;
+    h = t > 0xFFFFFFFF ? 0xFFFFFFFF : t;
+    for(b = 0; b < NLOCKHIST-1 && h >= 1 << (2*b+8); b++)
+      ;
+    lk->stat->hold[b]++;
+  }
+
+#ifdef LOCKDEBUG
   lk->pcs[0] = 0;
+#endif
   lk->cpu = 0;
 
   // Tell the C compiler and the processor to not move loads or stores
@@ -59,10 +116,10 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Release the lock: serve the next ticket.  Only the holder
+  // writes owner, but this code can't use a C assignment, since
+  // it might not be atomic. A real OS would use C atomics here.
+  asm volatile("movl %1, %0" : "+m" (lk->owner) : "r" (lk->owner + 1));
 
   popcli();
 }
@@ -89,7 +146,24 @@ getcallerpcs(void *v, uint pcs[])
 int
 holding(struct spinlock *lock)
 {
-  return lock->locked && lock->cpu == mycpu();
+  return lock->owner != lock->next && lock->cpu == mycpu();
+}
+
+// Copy the statistics of up to n locks to st.
+// Return how many were copied.
+int
+getlockstat(struct lockstat *st, int n)
+{
+  int i;
+
+  if(n > lockstats.n)
+    n = lockstats.n;
+  for(i = 0; i < n; i++){
+    st[i] = lockstats.stat[i];
+    safestrcpy(st[i].name, lockstats.lock[i]->name, sizeof(st[i].name));
+    st[i].spinkc = lockstats.lock[i]->spin >> 10;
+  }
+  return n;
 }
 
 
@@ -1,11 +1,19 @@
-// Mutual exclusion lock.
+// Mutual exclusion lock: a ticket lock, so waiters get the lock
+// in the order they asked for it.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket that holds the lock; free if owner == next.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+#ifdef LOCKDEBUG
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
-};
+#endif
 
+  // Statistics, kept for locks passed to lockstat():
+  struct lockstat *stat;       // 0 if not kept
+  unsigned long long spin;     // cycles spent waiting
+  unsigned long long tacquire; // when the holder got the lock
+};
@@ -13,34 +13,62 @@
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
 
+// Return the end of the user memory region of p that
+// contains addr, or 0 if addr is not in one.
+static uint
+uregionend(struct proc *p, uint addr)
+{
+  if(addr < p->sz)
+    return p->sz;
+  if(addr >= HUGEBASE && addr < HUGEBASE + p->hugesz)
+    return HUGEBASE + p->hugesz;
+  if(addr >= MMAPBASE && addr < MMAPTOP)
+    return mmapend(p, addr);
+  // Including stack pages not mapped yet (see ustack).
+  if(addr >= STACKTOP - MAXSTACK*PGSIZE && addr < STACKTOP)
+    return STACKTOP;
+  return 0;
+}
+
+// Grow the stack of p over addr, if it is below the pages
+// mapped so far, as a fault there would.  Return -1 if the
+// stack can not grow that far.
+static int
+ustack(struct proc *p, uint addr)
+{
+  if(addr >= STACKTOP - p->stacksz || addr < STACKTOP - MAXSTACK*PGSIZE)
+    return 0;
+  return growstack(p, addr) ? 0 : -1;
+}
+
 // Fetch the int at addr from the current process.
 int
 fetchint(uint addr, int *ip)
 {
-  struct proc *curproc = myproc();
+  uint end = uregionend(myproc(), addr);
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if(end == 0 || addr+4 > end || addr+4 < addr || ustack(myproc(), addr) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
 }
 
-// Fetch the nul-terminated string at addr from the current process.
-// Doesn't actually copy the string - just sets *pp to point at it.
+// Copy the nul-terminated string at addr from the current process
+// into buf, which holds max bytes.  A copy, since a MAP_SHARED page
+// can change under the kernel while it uses the string.
 // Returns length of string, not including nul.
 int
-fetchstr(uint addr, char **pp)
+fetchstr(uint addr, char *buf, int max)
 {
-  char *s, *ep;
-  struct proc *curproc = myproc();
+  int i;
+  uint end = uregionend(myproc(), addr);
 
-  if(addr >= curproc->sz)
+  if(end == 0 || ustack(myproc(), addr) < 0)
     return -1;
-  *pp = (char*)addr;
-  ep = (char*)curproc->sz;
-  for(s = *pp; s < ep; s++){
-    if(*s == 0)
-      return s - *pp;
+  for(i = 0; i < max && addr+i < end; i++){
+    buf[i] = *(char*)(addr+i);
+    if(buf[i] == 0)
+      return i;
   }
   return -1;
 }
@@ -56,30 +84,53 @@ argint(int n, int *ip)
 // to a block of memory of size bytes.  Check that the pointer
 // lies within the process address space.
 int
-argptr(int n, char **pp, int size)
+argaddr(int n, char **pp, int size)
 {
   int i;
-  struct proc *curproc = myproc();
+  uint end;
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  end = uregionend(myproc(), (uint)i);
+  if(size < 0 || end == 0 || (uint)i+size > end || (uint)i+size < (uint)i)
     return -1;
   *pp = (char*)i;
   return 0;
 }
 
-// Fetch the nth word-sized system call argument as a string pointer.
-// Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
+// Like argaddr, and also bring the block into memory and pin
+// it there until the system call returns, since the kernel
+// may not take page faults while it copies it (see iopin).
+int
+argptr(int n, char **pp, int size)
+{
+  if(argaddr(n, pp, size) < 0)
+    return -1;
+  return iopin(myproc(), (uint)*pp, size);
+}
+
+// Like argptr, but for a block the kernel is going to write,
+// so it must not lie in a read-only mapping.
+int
+argwptr(int n, char **pp, int size)
+{
+  if(argptr(n, pp, size) < 0)
+    return -1;
+  if(!mmapwritable(myproc(), (uint)*pp, size))
+    return -1;
+  return 0;
+}
+
+// Fetch the nth word-sized system call argument as a string
+// and copy it into buf, which holds max bytes (see fetchstr).
+// Call it before begin_op(): the copy may fault pages in.
 int
-argstr(int n, char **pp)
+argstr(int n, char *buf, int max)
 {
   int addr;
   if(argint(n, &addr) < 0)
     return -1;
-  return fetchstr(addr, pp);
+  return fetchstr(addr, buf, max);
 }
 
 extern int sys_chdir(void);
@@ -104,6 +155,15 @@ extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_yield(void);
+extern int sys_hugesbrk(void);
+extern int sys_madvise(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_mlock(void);
+extern int sys_munlock(void);
+extern int sys_setpolicy(void);
+extern int sys_getlockstat(void);
+extern int sys_prof(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -128,6 +188,15 @@ static int (*syscalls[])(void) = {
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
 [SYS_yield]   sys_yield,
+[SYS_hugesbrk] sys_hugesbrk,
+[SYS_madvise] sys_madvise,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_mlock]   sys_mlock,
+[SYS_munlock] sys_munlock,
+[SYS_setpolicy] sys_setpolicy,
+[SYS_getlockstat] sys_getlockstat,
+[SYS_prof]    sys_prof,
 };
 
 void
@@ -139,6 +208,7 @@ syscall(void)
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     curproc->tf->eax = syscalls[num]();
+    iounpin(curproc);
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
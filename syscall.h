@@ -21,3 +21,12 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_yield  22
+#define SYS_hugesbrk 23
+#define SYS_madvise 24
+#define SYS_mmap   25
+#define SYS_munmap 26
+#define SYS_mlock  27
+#define SYS_munlock 28
+#define SYS_setpolicy 29
+#define SYS_getlockstat 30
+#define SYS_prof   31
@@ -66,6 +66,32 @@ sys_dup(void)
   return fd;
 }
 
+// Read or write the n bytes at p a few pages at a time, each
+// piece pinned in memory while the file system copies it, since
+// all of them may not fit in memory at once (see iopin).
+static int
+fileio(struct file *f, char *p, int n, int write)
+{
+  int done = 0, m, r;
+
+  do {
+    m = MAX_IO_PAGES*PGSIZE - (uint)(p + done) % PGSIZE;
+    if(m > n - done)
+      m = n - done;
+    if(iopin(myproc(), (uint)(p + done), m) < 0)
+      return done > 0 ? done : -1;
+    r = write ? filewrite(f, p + done, m) : fileread(f, p + done, m);
+    iounpin(myproc());
+    if(r < 0)
+      return done > 0 ? done : -1;
+    done += r;
+    // A pipe or device read returns what there is; don't wait for more.
+    if(r < m || (!write && f->type != FD_INODE))
+      break;
+  } while(done < n);
+  return done;
+}
+
 int
 sys_read(void)
 {
@@ -73,9 +99,11 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p, n) < 0)
+    return -1;
+  if(!mmapwritable(myproc(), (uint)p, n))
     return -1;
-  return fileread(f, p, n);
+  return fileio(f, p, n, 0);
 }
 
 int
@@ -85,9 +113,9 @@ sys_write(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p, n) < 0)
     return -1;
-  return filewrite(f, p, n);
+  return fileio(f, p, n, 1);
 }
 
 int
@@ -109,7 +137,7 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argwptr(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -118,10 +146,10 @@ sys_fstat(void)
 int
 sys_link(void)
 {
-  char name[DIRSIZ], *new, *old;
+  char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
   struct inode *dp, *ip;
 
-  if(argstr(0, &old) < 0 || argstr(1, &new) < 0)
+  if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
     return -1;
 
   begin_op();
@@ -186,10 +214,10 @@ sys_unlink(void)
 {
   struct inode *ip, *dp;
   struct dirent de;
-  char name[DIRSIZ], *path;
+  char name[DIRSIZ], path[MAXPATH];
   uint off;
 
-  if(argstr(0, &path) < 0)
+  if(argstr(0, path, MAXPATH) < 0)
     return -1;
 
   begin_op();
@@ -286,12 +314,12 @@ create(char *path, short type, short major, short minor)
 int
 sys_open(void)
 {
-  char *path;
+  char path[MAXPATH];
   int fd, omode;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
     return -1;
 
   begin_op();
@@ -336,11 +364,13 @@ sys_open(void)
 int
 sys_mkdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
 
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+  if((ip = create(path, T_DIR, 0, 0)) == 0){
     end_op();
     return -1;
   }
@@ -353,14 +383,15 @@ int
 sys_mknod(void)
 {
   struct inode *ip;
-  char *path;
+  char path[MAXPATH];
   int major, minor;
 
-  begin_op();
-  if((argstr(0, &path)) < 0 ||
+  if((argstr(0, path, MAXPATH)) < 0 ||
      argint(1, &major) < 0 ||
-     argint(2, &minor) < 0 ||
-     (ip = create(path, T_DEV, major, minor)) == 0){
+     argint(2, &minor) < 0)
+    return -1;
+  begin_op();
+  if((ip = create(path, T_DEV, major, minor)) == 0){
     end_op();
     return -1;
   }
@@ -372,12 +403,14 @@ sys_mknod(void)
 int
 sys_chdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
   struct proc *curproc = myproc();
   
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = namei(path)) == 0){
+  if((ip = namei(path)) == 0){
     end_op();
     return -1;
   }
@@ -397,27 +430,37 @@ sys_chdir(void)
 int
 sys_exec(void)
 {
-  char *path, *argv[MAXARG];
-  int i;
+  char path[MAXPATH], *argv[MAXARG], *strs;
+  int i, n, off, r;
   uint uargv, uarg;
 
-  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, (int*)&uargv) < 0){
     return -1;
   }
+  // The strings are copied as the path is; they all go on one
+  // page of the new stack anyway.
+  if((strs = kalloc()) == 0)
+    return -1;
   memset(argv, 0, sizeof(argv));
-  for(i=0;; i++){
+  r = -1;
+  for(i=0, off=0;; i++){
     if(i >= NELEM(argv))
-      return -1;
+      goto out;
     if(fetchint(uargv+4*i, (int*)&uarg) < 0)
-      return -1;
+      goto out;
     if(uarg == 0){
       argv[i] = 0;
       break;
     }
-    if(fetchstr(uarg, &argv[i]) < 0)
-      return -1;
+    if((n = fetchstr(uarg, strs+off, PGSIZE-off)) < 0)
+      goto out;
+    argv[i] = strs+off;
+    off += n+1;
   }
-  return exec(path, argv);
+  r = exec(path, argv);
+out:
+  kfree(strs);
+  return r;
 }
 
 int
@@ -427,7 +470,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argwptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -443,3 +486,25 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int len, prot, flags, off;
+
+  if(argint(1, &len) < 0 || argint(2, &prot) < 0 || argint(3, &flags) < 0 ||
+     argfd(4, 0, &f) < 0 || argint(5, &off) < 0)
+    return -1;
+  return mmap(f, len, prot, flags, off);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap(addr, len);
+}
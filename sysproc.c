@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "lockstat.h"
+#include "prof.h"
 
 
 int sys_yield(void)
@@ -67,21 +69,37 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return timersleep(n);
+}
+
+// Grow the huge-page region by n bytes, rounded up to 4 MB.
+// Returns the old end of the region.
+int
+sys_hugesbrk(void)
+{
+  int addr;
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  addr = HUGEBASE + myproc()->hugesz;
+  if(growhuge(n) < 0)
+    return -1;
+  return addr;
+}
+
+int
+sys_madvise(void)
+{
+  char *addr;
+  int len, advice;
+
+  if(argint(1, &len) < 0 || argaddr(0, &addr, len) < 0 || argint(2, &advice) < 0)
+    return -1;
+  return madvise(myproc(), (uint)addr, len, advice);
 }
 
 // return how many clock tick interrupts have occurred
@@ -96,3 +114,70 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+int
+sys_mlock(void)
+{
+  char *addr;
+  int len;
+
+  if(argint(1, &len) < 0 || argaddr(0, &addr, len) < 0)
+    return -1;
+  return mlock(myproc(), (uint)addr, len);
+}
+
+int
+sys_munlock(void)
+{
+  char *addr;
+  int len;
+
+  if(argint(1, &len) < 0 || argaddr(0, &addr, len) < 0)
+    return -1;
+  return munlock(myproc(), (uint)addr, len);
+}
+
+int
+sys_setpolicy(void)
+{
+  int policy, global;
+
+  if(argint(0, &policy) < 0 || argint(1, &global) < 0)
+    return -1;
+  return setpolicy(myproc(), policy, global);
+}
+
+// Copy the statistics of up to n hot spinlocks to st.
+int
+sys_getlockstat(void)
+{
+  struct lockstat *st;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NLOCKSTAT)
+    n = NLOCKSTAT;
+  if(argwptr(0, (char**)&st, n*sizeof(*st)) < 0)
+    return -1;
+  return getlockstat(st, n);
+}
+
+// Start or stop the kernel profiler, or drain up to n of its
+// samples to buf.
+int
+sys_prof(void)
+{
+  struct profsample *st;
+  int cmd, n;
+
+  if(argint(0, &cmd) < 0 || argint(2, &n) < 0 || n < 0)
+    return -1;
+  if(cmd != PROF_DRAIN)
+    return profctl(cmd, 0, 0);
+  if(n > 1024)
+    n = 1024;
+  if(argwptr(1, (char**)&st, n*sizeof(*st)) < 0)
+    return -1;
+  return profctl(cmd, st, n);
+}
@@ -0,0 +1,192 @@
+// Timekeeping without a periodic tick.
+//
+// ticks counts TICKHZ ticks since boot, read off the TSC, so it
+// does not depend on which CPUs take timer interrupts.  A CPU
+// running processes arms its one-shot LAPIC timer one tick ahead
+// (for preemption, and the global work of each tick); an idle one
+// arms it only for the next sleep() deadline, and only when no
+// other CPU is ticking.  Processes in sleep() wait on a timer wheel,
+// so a tick wakes only the ones whose time has come.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+
+#define NWHEEL 64   // wheel buckets, by deadline modulo NWHEEL
+
+struct spinlock tickslock;
+uint ticks;
+
+static uint tscpertick;
+static unsigned long long tscboot;
+
+// Sleepers by wakeat % NWHEEL, chained through p->tnext.
+// Guarded by tickslock.
+static struct proc *wheel[NWHEEL];
+
+void
+timerinit(void)
+{
+  initlock(&tickslock, "time");
+  if((tscpertick = lapictsc()) == 0)
+    tscpertick = 1;
+  tscboot = rdtsc();
+}
+
+// Ticks since boot.
+static uint
+timenow(void)
+{
+  unsigned long long t = rdtsc() - tscboot;
+  uint hi = (uint)(t >> 32) % tscpertick, lo = (uint)t, q, r;
+
+  asm volatile("divl %4" : "=a" (q), "=d" (r) : "a" (lo), "d" (hi), "rm" (tscpertick));
+  return q;
+}
+
+// Wake the sleepers of bucket b whose deadline is not after now.
+static void
+expire(int b, uint now)
+{
+  struct proc **pp, *p;
+
+  pp = &wheel[b];
+  while((p = *pp) != 0){
+    if((int)(now - p->wakeat) < 0){
+      pp = &p->tnext;
+      continue;
+    }
+    *pp = p->tnext;
+    p->tnext = 0;
+    wakeup(&p->wakeat);
+  }
+}
+
+// Bring ticks up to date, expire the sleepers and do the global
+// work of each tick that passed.  Any CPU may call it: each tick
+// is done once, by whichever CPU sees it first.
+static void
+advance(void)
+{
+  uint now, n, t;
+
+  acquire(&tickslock);
+  now = timenow();
+  n = now - ticks;
+  if(n >= NWHEEL){
+    for(t = 0; t < NWHEEL; t++)
+      expire(t, now);
+  } else {
+    for(t = ticks+1; t != now+1; t++)
+      expire(t % NWHEEL, now);
+  }
+  t = ticks;
+  ticks = now;
+  release(&tickslock);
+
+  if(n == 0)
+    return;
+  // More ticks than an access tracker has bits age every page out.
+  for(t = n < 32 ? n : 32; t > 0; t--)
+    update_policies_for_all();
+  if(now / MLFQBOOST != (now - n) / MLFQBOOST)
+    mlfqboost();
+}
+
+// Timer interrupt: keep ticking while a process runs here.
+void
+timertick(void)
+{
+  advance();
+  if(myproc())
+    lapictimer(1);
+  else
+    mycpu()->ticking = 0;
+}
+
+// scheduler() has work: tick while running it.
+// Interrupts must be off.
+void
+timerbusy(void)
+{
+  struct cpu *c = mycpu();
+
+  if(c->ticking)
+    return;
+  c->ticking = 1;
+  advance();   // ticks may have stood still while all CPUs were idle
+  lapictimer(1);
+}
+
+// scheduler() is about to halt: stop the timer, unless no other
+// CPU is ticking and sleep() has a deadline to meet.
+// Interrupts must be off.
+void
+timeridle(void)
+{
+  struct cpu *c = mycpu(), *o;
+  struct proc *p;
+  uint now, next;
+  int b;
+
+  // Stop ticking before looking at the others, so that of two
+  // CPUs going idle together at least one sees the other stopped.
+  xchg(&c->ticking, 0);
+  for(o = cpus; o < cpus+ncpu; o++){
+    if(o != c && o->ticking){
+      lapictimer(0);
+      return;
+    }
+  }
+
+  next = 0;
+  acquire(&tickslock);
+  now = timenow();
+  for(b = 0; b < NWHEEL; b++){
+    for(p = wheel[b]; p; p = p->tnext){
+      if((int)(p->wakeat - now) <= 0)
+        next = 1;
+      else if(next == 0 || p->wakeat - now < next)
+        next = p->wakeat - now;
+    }
+  }
+  release(&tickslock);
+  lapictimer(next);
+}
+
+// Sleep for n ticks.  Return -1 if killed meanwhile.
+int
+timersleep(int n)
+{
+  struct proc *p = myproc();
+  struct proc **pp;
+
+  acquire(&tickslock);
+  if(n <= 0){
+    release(&tickslock);
+    return 0;
+  }
+  p->wakeat = ticks + n;
+  p->tnext = wheel[p->wakeat % NWHEEL];
+  wheel[p->wakeat % NWHEEL] = p;
+  while((int)(ticks - p->wakeat) < 0){
+    if(p->killed){
+      for(pp = &wheel[p->wakeat % NWHEEL]; *pp; pp = &(*pp)->tnext){
+        if(*pp == p){
+          *pp = p->tnext;
+          p->tnext = 0;
+          break;
+        }
+      }
+      release(&tickslock);
+      return -1;
+    }
+    sleep(&p->wakeat, &tickslock);
+  }
+  release(&tickslock);
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Kernel event trace.
+//
+// trace() appends an rdtsc()-stamped event to its CPU's ring without
+// taking any lock: only that CPU writes the ring, with interrupts
+// off, and it only moves w; the reader only moves r.  A full ring
+// drops new events and counts them, so reading never races with
+// an overwrite.  Events are read, oldest first per CPU, through the
+// trace device (see trace.h).
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "trace.h"
+
+#define NTRACEBUF 1024  // events per CPU
+
+static struct {
+  struct traceev buf[NTRACEBUF];
+  volatile uint r, w;  // events read and written, w-r are in buf
+  volatile uint lost;  // events dropped since the last read
+} tring[NCPU];
+
+static volatile uint tracemask;
+static struct sleeplock tracereader;
+
+// Record an event of type about p (0 for the current process).
+void
+trace(int type, struct proc *p, uint a, uint b)
+{
+  struct traceev *e;
+  struct cpu *c;
+  unsigned long long t;
+  int i;
+
+  if(!(tracemask & (1 << type)))
+    return;
+  pushcli();
+  c = mycpu();
+  i = c - cpus;
+  if(p == 0)
+    p = c->proc;
+  if(tring[i].w - tring[i].r == NTRACEBUF)
+    tring[i].lost++;
+  else {
+    e = &tring[i].buf[tring[i].w % NTRACEBUF];
+    t = rdtsc();
+    e->tsclo = t;
+    e->tshi = t >> 32;
+    e->type = type;
+    e->cpu = i;
+    e->pid = p ? p->pid : 0;
+    e->a = a;
+    e->b = b;
+    __sync_synchronize();   // the event before the reader sees it
+    tring[i].w++;
+  }
+  popcli();
+}
+
+// Read as many whole events as fit in n bytes; 0 if there are none.
+static int
+traceread(struct inode *ip, char *dst, int n)
+{
+  struct traceev e;
+  int i, got;
+
+  iunlock(ip);
+  acquiresleep(&tracereader);
+  got = 0;
+  for(i = 0; i < ncpu && n - got >= sizeof(e); ){
+    if(tring[i].lost){
+      memset(&e, 0, sizeof(e));
+      e.type = TR_LOST;
+      e.cpu = i;
+      e.a = __sync_lock_test_and_set(&tring[i].lost, 0);
+    } else if(tring[i].r != tring[i].w){
+      e = tring[i].buf[tring[i].r % NTRACEBUF];
+      __sync_synchronize();   // the copy before the writer reuses the slot
+      tring[i].r++;
+    } else {
+      i++;
+      continue;
+    }
+    // The copy to user memory may fault, so no spinlock is held.
+    memmove(dst + got, &e, sizeof(e));
+    got += sizeof(e);
+  }
+  releasesleep(&tracereader);
+  ilock(ip);
+  return got;
+}
+
+// Set the mask of events to record from a decimal number.
+static int
+tracewrite(struct inode *ip, char *src, int n)
+{
+  uint mask = 0;
+  int i;
+
+  for(i = 0; i < n && src[i] >= '0' && src[i] <= '9'; i++)
+    mask = mask*10 + src[i] - '0';
+  tracemask = mask;
+  return n;
+}
+
+void
+traceinit(void)
+{
+  initsleeplock(&tracereader, "tracereader");
+  devsw[TRACE].read = traceread;
+  devsw[TRACE].write = tracewrite;
+}
@@ -0,0 +1,27 @@
+// Kernel event trace (see trace.c), read from the trace device.
+// Writing a decimal mask of (1 << TR_*) bits to the device chooses
+// the events to record; writing 0 stops tracing.
+
+#define TRACE       2   // major device number of the trace device
+
+#define TR_LOST     1   // a: events this CPU dropped because its buffer was full
+#define TR_SWAP     2   // swap(): a: page being added, b: page swapped out for it
+#define TR_SWAPIN   3   // swap_in(): a: faulting page
+#define TR_PAGEOUT  4   // page_out(): a: page, b: place in swap file
+#define TR_PAGEIN   5   // page_in(): a: page, b: place in swap file
+#define TR_VICTIM   6   // victim selection: a: page, b: 1 if picked by an madvise() hint
+#define TR_REF      7   // a replacement policy saw page a referenced (its PTE_A)
+#define TR_IOSTART  8   // iderw(): a: block, b: 1 if a write
+#define TR_IODONE   9   // ideintr(): a: block, b: 1 if a write
+#define TR_BEGINOP 10   // begin_op(): a: FS system calls now in progress
+#define TR_COMMIT  11   // end_op() commits: a: blocks in the transaction
+#define TR_SWITCH  12   // scheduler() runs the process, a: its MLFQ level
+#define NTRACE     13
+
+struct traceev {
+  uint tsclo, tshi;    // rdtsc() when it happened
+  ushort type;         // TR_*
+  ushort cpu;
+  int pid;             // process it happened to, 0 if none
+  uint a, b;           // see TR_*
+};
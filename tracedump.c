@@ -0,0 +1,127 @@
+// Dump the kernel event trace (see trace.h):
+//
+//   tracedump [-r pid] [command [args...]]
+//
+// With a command, traces while it runs and then prints the events;
+// without one, streams them until killed.  With -r, prints instead
+// the pages that process pid referenced or faulted on, one address
+// per line, which pagesim replays as a recorded trace.
+
+#include "types.h"
+#include "stat.h"
+#include "fcntl.h"
+#include "user.h"
+#include "trace.h"
+
+#define NEV 64
+
+static char *names[] = {
+[TR_LOST]     "lost",
+[TR_SWAP]     "swap",
+[TR_SWAPIN]   "swapin",
+[TR_PAGEOUT]  "pageout",
+[TR_PAGEIN]   "pagein",
+[TR_VICTIM]   "victim",
+[TR_REF]      "ref",
+[TR_IOSTART]  "iostart",
+[TR_IODONE]   "iodone",
+[TR_BEGINOP]  "beginop",
+[TR_COMMIT]   "commit",
+[TR_SWITCH]   "switch",
+};
+
+static int replay = -1;     // pid whose references to print, or -1
+static unsigned long long t0;  // time of the first event
+static int started;
+
+static void
+print(struct traceev *e)
+{
+  unsigned long long t;
+
+  if(replay >= 0){
+    if(e->pid == replay && (e->type == TR_REF || e->type == TR_SWAPIN || e->type == TR_SWAP))
+      printf(1, "0x%x\n", e->a);
+    if(e->type == TR_LOST)
+      printf(1, "# %d events lost\n", e->a);
+    return;
+  }
+  if(e->type == TR_LOST){
+    printf(1, "cpu%d lost %d events\n", e->cpu, e->a);
+    return;
+  }
+  t = (unsigned long long)e->tshi << 32 | e->tsclo;
+  if(!started){
+    t0 = t;
+    started = 1;
+  }
+  // Time since the first event, in units of 1024 cycles.
+  printf(1, "%d cpu%d pid %d %s 0x%x %d\n", (uint)((t - t0) >> 10), e->cpu, e->pid,
+         e->type < NTRACE ? names[e->type] : "?", e->a, e->b);
+}
+
+// Print the events read so far; return how many there were.
+static int
+drain(int fd)
+{
+  struct traceev ev[NEV];
+  int i, n, total = 0;
+
+  while((n = read(fd, (char*)ev, sizeof(ev))) > 0){
+    for(i = 0; i < n / sizeof(ev[0]); i++)
+      print(&ev[i]);
+    total += n / sizeof(ev[0]);
+  }
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct traceev ev[NEV];
+  int fd, pid;
+  char *mask;
+
+  argv++;
+  argc--;
+  if(argc >= 2 && strcmp(argv[0], "-r") == 0){
+    replay = atoi(argv[1]);
+    argv += 2;
+    argc -= 2;
+  }
+
+  if((fd = open("trace", O_RDWR)) < 0){
+    mknod("trace", TRACE, 0);
+    if((fd = open("trace", O_RDWR)) < 0){
+      printf(2, "tracedump: cannot open trace\n");
+      exit();
+    }
+  }
+  // Drop the events left over from an earlier run.
+  while(read(fd, (char*)ev, sizeof(ev)) > 0)
+    ;
+
+  if(replay >= 0)
+    mask = "140";    // TR_SWAP, TR_SWAPIN and TR_REF
+  else
+    mask = "8190";   // all of them
+  write(fd, mask, strlen(mask));
+
+  if(argc == 0){
+    for(;;){
+      if(drain(fd) == 0)
+        sleep(1);
+    }
+  }
+
+  if((pid = fork()) == 0){
+    exec(argv[0], argv);
+    printf(2, "tracedump: exec %s failed\n", argv[0]);
+    exit();
+  }
+  if(pid > 0)
+    wait();
+  write(fd, "0", 1);
+  drain(fd);
+  exit();
+}
@@ -12,8 +12,6 @@
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
-struct spinlock tickslock;
-uint ticks;
 
 
 int
@@ -32,8 +30,6 @@ tvinit(void)
   for(i = 0; i < 256; i++)
     SETGATE(idt[i], 0, SEG_KCODE<<3, vectors[i], 0);
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
-
-  initlock(&tickslock, "time");
 }
 
 void
@@ -59,30 +55,18 @@ trap(struct trapframe *tf)
   struct proc* p;
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
-    if(cpuid() == 0){
-      acquire(&tickslock);
-      ticks++;
-      wakeup(&ticks);
-      release(&tickslock);
-
-      #if NFUA
-        update_access_trackers_for_all();
-      #endif
-      
-      #if LAPA
-        update_access_trackers_for_all();
-      #endif
-
-      #if AQ
-        update_adv_queues_for_all();
-      #endif
-    }
+    profsample(tf);
+    timertick();
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Woke a halted scheduler(), which looks at the run queues again.
+    lapiceoi();
+    break;
   case T_IRQ0 + IRQ_IDE+1:
     // Bochs generates spurious IDE1 interrupts.
     break;
@@ -108,12 +92,25 @@ trap(struct trapframe *tf)
   case T_PGFLT:
 
     p = myproc();
-    if (p != 0 && !is_shell_or_init(p) &&
-      (tf->cs&3) == 3 && is_page_in_file(p, rcr2())){
-      
-      if(swap_in(p, rcr2())){
-        break;
+    // Faults on user memory from the kernel (e.g. reading system call arguments)
+    // are served too, unless it holds a lock or is in a log transaction: serving
+    // may sleep, lock inodes and write the swap file.  System call buffers that
+    // the file system copies holding those are pinned beforehand (see iopin).
+    if (p != 0 && ((tf->cs&3) == 3 || (rcr2() < KERNBASE && mycpu()->ncli == 0 &&
+        p->nsleeplock == 0 && p->logop == 0))){
+
+      if (!is_shell_or_init(p) && is_page_in_file(p, rcr2())){
+        if(swap_in(p, rcr2()))
+          break;
+      }
+      if (is_zero_fill_page(p, rcr2())){
+        if(zero_fill_in(p, rcr2()))
+          break;
       }
+      if (mmapfault(p, rcr2(), tf->err & 2))
+        break;
+      if (growstack(p, rcr2()))
+        break;
     }
     // panic("bla");
     // break;
@@ -139,10 +136,11 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU on clock tick once its quantum
+  // is used up or a higher-priority process is waiting (see mlfqtick).
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     tf->trapno == T_IRQ0+IRQ_TIMER && mlfqtick())
     yield();
 
   // Check if the process has been killed since we yielded
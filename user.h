@@ -1,5 +1,7 @@
 struct stat;
 struct rtcdate;
+struct lockstat;
+struct profsample;
 
 // system calls
 int fork(void);
@@ -24,6 +26,15 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int yield(void);
+char* hugesbrk(int);
+int madvise(void*, uint, int);
+void* mmap(void*, uint, int, int, int, uint);
+int munmap(void*, uint);
+int mlock(void*, uint);
+int munlock(void*, uint);
+int setpolicy(int, int);
+int getlockstat(struct lockstat*, int);
+int prof(int, struct profsample*, int);
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -6,6 +6,10 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "madvise.h"
+#include "policy.h"
+#include "pagepolicy.h"
+#include "trace.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -31,14 +35,17 @@ seginit(void)
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
-// create any required page table pages.
-static pte_t *
+// create any required page table pages.  For a 4 MB page
+// the directory entry itself is returned (check PTE_PS).
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
   pte_t *pgtab;
 
   pde = &pgdir[PDX(va)];
+  if((*pde & (PTE_P|PTE_PS)) == (PTE_P|PTE_PS))
+    return pde;
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
@@ -114,7 +121,42 @@ static struct kmap {
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
+// Map one kmap range into pgdir.  Writable ranges that cover a
+// whole 4 MB aligned chunk get a single PSE directory entry for it
+// instead of a page-table page full of PTEs.  Kernel mappings are
+// the same in every address space, so they are marked global and
+// survive %cr3 loads in the TLB.
+static int
+mapkvm(pde_t *pgdir, struct kmap *k)
+{
+  uint a, pa, left;
+
+  a = (uint)k->virt;
+  pa = k->phys_start;
+  left = k->phys_end - k->phys_start;
+  while(left > 0){
+    if((k->perm & PTE_W) && a % PGSIZE4M == 0 && pa % PGSIZE4M == 0 &&
+       left >= PGSIZE4M && !(pgdir[PDX(a)] & PTE_P)){
+      pgdir[PDX(a)] = pa | k->perm | PTE_P | PTE_PS | PTE_G;
+      a += PGSIZE4M;
+      pa += PGSIZE4M;
+      left -= PGSIZE4M;
+      continue;
+    }
+    if(mappages(pgdir, (void*)a, PGSIZE, pa, k->perm | PTE_G) < 0)
+      return -1;
+    a += PGSIZE;
+    pa += PGSIZE;
+    left -= PGSIZE;
+  }
+  return 0;
+}
+
 // Set up kernel part of a page table.
+// The kernel mappings are built once, in kpgdir, and every other
+// page directory just copies kpgdir's directory entries above
+// KERNBASE, so all address spaces share the kernel's page-table
+// pages.  freevm() never frees those.
 pde_t*
 setupkvm(void)
 {
@@ -124,14 +166,17 @@ setupkvm(void)
   if((pgdir = (pde_t*)kalloc()) == 0)
     return 0;
   memset(pgdir, 0, PGSIZE);
+  if(kpgdir){
+    memmove(&pgdir[PDX(KERNBASE)], &kpgdir[PDX(KERNBASE)],
+            (NPDENTRIES - PDX(KERNBASE)) * sizeof(pde_t));
+    return pgdir;
+  }
+
   if (P2V(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
-    if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
-                (uint)k->phys_start, k->perm) < 0) {
-      freevm(pgdir);
-      return 0;
-    }
+    if(mapkvm(pgdir, k) < 0)
+      panic("setupkvm: out of memory");
   return pgdir;
 }
 
@@ -141,7 +186,15 @@ void
 kvmalloc(void)
 {
   kpgdir = setupkvm();
+  kvmenable();
+}
+
+// Load kpgdir and turn on global pages on this CPU.
+void
+kvmenable(void)
+{
   switchkvm();
+  lcr4(rcr4() | CR4_PGE);
 }
 
 // Switch h/w page table register to the kernel-only page table,
@@ -152,6 +205,21 @@ switchkvm(void)
   lcr3(V2P(kpgdir));   // switch to the kernel page table
 }
 
+// Point the TSS at p's kernel stack.  Caller must hold pushcli.
+static void
+settss(struct proc *p)
+{
+  mycpu()->gdt[SEG_TSS] = SEG16(STS_T32A, &mycpu()->ts,
+                                sizeof(mycpu()->ts)-1, 0);
+  mycpu()->gdt[SEG_TSS].s = 0;
+  mycpu()->ts.ss0 = SEG_KDATA << 3;
+  mycpu()->ts.esp0 = (uint)p->kstack + KSTACKSIZE;
+  // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
+  // forbids I/O instructions (e.g., inb and outb) from user space
+  mycpu()->ts.iomb = (ushort) 0xFFFF;
+  ltr(SEG_TSS << 3);
+}
+
 // Switch TSS and h/w page table to correspond to process p.
 void
 switchuvm(struct proc *p)
@@ -164,17 +232,60 @@ switchuvm(struct proc *p)
     panic("switchuvm: no pgdir");
 
   pushcli();
-  mycpu()->gdt[SEG_TSS] = SEG16(STS_T32A, &mycpu()->ts,
-                                sizeof(mycpu()->ts)-1, 0);
-  mycpu()->gdt[SEG_TSS].s = 0;
-  mycpu()->ts.ss0 = SEG_KDATA << 3;
-  mycpu()->ts.esp0 = (uint)p->kstack + KSTACKSIZE;
-  // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
-  // forbids I/O instructions (e.g., inb and outb) from user space
-  mycpu()->ts.iomb = (ushort) 0xFFFF;
-  ltr(SEG_TSS << 3);
+  settss(p);
   lcr3(V2P(p->pgdir));  // switch to process's address space
+  mycpu()->pgdir = p->pgdir;
+  p->lastcpu = mycpu();
+  popcli();
+}
+
+// Like switchuvm, but used by the scheduler: if this CPU still has
+// p's page table loaded and p has not run anywhere else since, the
+// TLB still holds exactly p's mappings and the %cr3 load (and the
+// flush that comes with it) is skipped.
+void
+resumeuvm(struct proc *p)
+{
+  struct cpu *c;
+
+  if(p->kstack == 0 || p->pgdir == 0)
+    panic("resumeuvm");
+
+  pushcli();
+  c = mycpu();
+  settss(p);
+  if(c->pgdir != p->pgdir || p->lastcpu != c){
+    lcr3(V2P(p->pgdir));
+    c->pgdir = p->pgdir;
+  }
+  p->lastcpu = c;
+  popcli();
+}
+
+// Idle CPUs keep the last process's page table loaded (see
+// scheduler), so before pgdir is freed make sure no other CPU is
+// still using it.  Must not be called holding ptable.lock, which the
+// idle CPUs need in order to notice the request.
+void
+retirepgdir(pde_t *pgdir)
+{
+  struct cpu *c;
+
+  pushcli();
+  if(mycpu()->pgdir == pgdir){
+    switchkvm();
+    mycpu()->pgdir = 0;
+  }
   popcli();
+
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->pgdir == pgdir){
+      c->dropcr3 = 1;
+      cpuwake(c);   // it may be halted in scheduler()
+    }
+    while(c->pgdir == pgdir)
+      c->dropcr3 = 1;
+  }
 }
 
 // Load the initcode into address 0 of pgdir.
@@ -218,161 +329,83 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 
 
 /*
-* Gets the index of page in memory which should be swapped-out according to the defined policy
+* The process whose pages page_refbit() looks at on each CPU, for the TR_REF trace events.
+* Set under lockpagemap(p), so the CPU cannot change meanwhile
 */
-int find_avail_page_index_to_swapout(struct proc* p){
-  #if NFUA
-    return find_avail_index_by_NFUA(p);
-  #endif
-  #if LAPA
-    return find_avail_index_by_LAPA(p);
-  #endif
-  #if SCFIFO
-    return find_avail_index_by_SCFIFO(p);
-  #endif
-  #if AQ
-    return find_avail_index_by_AQ(p);
-  #endif
-  panic("find_avail_page_index_to_swapout: policy error");
-}
-
-int find_avail_index_by_NFUA(struct proc* p){
-
-  int min = -1;
+static struct proc* refowner[NCPU];
 
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
-      continue;
-    
-    if((min == -1) || (p->ram_manager[min].access_tracker > p->ram_manager[i].access_tracker)){
-      min = i;
-    }
-  }
-
-  return min;
+static void refs_of(struct proc* p){
+  refowner[cpuid()] = p;
 }
 
-int find_avail_index_by_LAPA(struct proc* p){
-
-  int min = -1;
-
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
-      continue;
-
-    if((min == -1) || (countNumOfOneBits(p->ram_manager[min].access_tracker) > countNumOfOneBits(p->ram_manager[i].access_tracker))){
-      min = i;
-    }
+/*
+* Gets the index of page in memory which should be swapped-out according to the defined policy
+*/
+int find_avail_page_index_to_swapout(struct proc* p){
+  int hinted = find_hinted_victim(p);
+  if(hinted >= 0){
+    trace(TR_VICTIM, p, p->ram_manager[hinted].vAddr, 1);
+    return hinted;
   }
 
-  return min;
+  if(check_NONE_policy())
+    panic("find_avail_page_index_to_swapout: policy error");
+  refs_of(p);
+  int victim = proc_policy(p)->pick_victim(p);
+  if(victim >= 0)
+    trace(TR_VICTIM, p, p->ram_manager[victim].vAddr, 0);
+  return victim;
 }
 
+/*
+* Tells if the page was referenced since the last look (its PTE_A flag), and clears that if clear
+*/
+static int page_refbit(struct page_struct* page, int clear){
 
-int find_avail_index_by_SCFIFO(struct proc* p){
-
-  pte_t* pte;
-  int min = -1;
-
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
-      continue;
-
-    if((min == -1) || (p->ram_manager[min].create_order > p->ram_manager[i].create_order)){
-      min = i;
-    }
-  }
+  pte_t* pte = walkpgdir(page->pgdir, (char*)page->vAddr, 0);
+  int referenced = (*pte & PTE_A) != 0;
 
-  pte = walkpgdir(p->ram_manager[min].pgdir, (char*)p->ram_manager[min].vAddr,0);
-  
-  // If the page was accessed..
-  if (*pte & PTE_A) {
+  if(referenced && clear){
     *pte &= ~PTE_A; // turn off PTE_A flag
-     p->ram_manager[min].create_order = generate_creation_number(p); // update page's create_order to be the highest (treat it like it was just created)
-     return find_avail_index_by_SCFIFO(p);
+    trace(TR_REF, refowner[cpuid()], page->vAddr, 0);
   }
-
-  return min;
+  return referenced;
 }
 
-int find_avail_index_by_AQ(struct proc* p){
-
-  int min = -1;
-
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
-      continue;
-
-    if((min == -1) || (p->ram_manager[min].adv_queue > p->ram_manager[i].adv_queue)){
-      min = i;
-    }
-  }
-
-  return min;
+/*
+* The victim selectors themselves live in pagepolicy.c, which the host simulator shares
+*/
+int find_avail_index_by_NFUA(struct proc* p){
+  return pp_victim_NFUA(p->ram_manager, MAX_PSYC_PAGES);
 }
 
-
-uint countNumOfOneBits(uint n){
-    uint counter = 0;
-    while(n) {
-        counter += n % 2;
-        n >>= 1;
-    }
-    return counter;
+int find_avail_index_by_LAPA(struct proc* p){
+  return pp_victim_LAPA(p->ram_manager, MAX_PSYC_PAGES);
 }
 
-
-
-
-int findNextAQPageIndex(struct proc* p, int index){
-  
-  
-  int ans = -1;
-  if(index >= 0){ // Find the next in advQueu after page
-    ans = findNextAdvPageIndex(p, p->ram_manager[index].adv_queue);
-  }
-  else{ // Find the first in advQueu
-    ans = findMinAdvPageIndex(p);
-  }
-
-  return ans;
+int find_avail_index_by_SCFIFO(struct proc* p){
+  return pp_victim_SCFIFO(p->ram_manager, MAX_PSYC_PAGES, page_refbit, &p->create_order_counter);
 }
 
-int findNextAdvPageIndex(struct proc* p, int boundery){
-
-  uint min = -1;
-  for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
-      continue;
-    if(p->ram_manager[i].adv_queue <= boundery)
-      continue;
-
-    // Here p->ram_manager[i] is in the ram and grater than boundery
-    if((min < 0) || (p->ram_manager[min].adv_queue > p->ram_manager[i].adv_queue)){
-      min = i;
-    }
-  }
-
-  return min;
+int find_avail_index_by_AQ(struct proc* p){
+  return pp_victim_AQ(p->ram_manager, MAX_PSYC_PAGES);
 }
 
-
-int findMinAdvPageIndex(struct proc* p){
-  return findNextAdvPageIndex(p, 0xFFFFFFFF);
+int find_avail_index_by_ARC(struct proc* p){
+  return pp_victim_ARC(p->ram_manager, MAX_PSYC_PAGES, &p->arc, page_refbit, &p->create_order_counter);
 }
 
-void swap_adv_queue(struct proc* p, int priorPageIndex, int afterPageIndex){
-
-  int tmpTurn = 0;
-  tmpTurn = p->ram_manager[priorPageIndex].adv_queue;
-  p->ram_manager[priorPageIndex].adv_queue = p->ram_manager[afterPageIndex].adv_queue;
-  p->ram_manager[afterPageIndex].adv_queue = tmpTurn;
+/*
+* ARC learns from the pages coming in, whether new or swapped-in (ghost hits)
+*/
+static void admit_page_by_ARC(struct proc* p, int index){
+  pp_admit_ARC(p->ram_manager, MAX_PSYC_PAGES, index, &p->arc, &p->create_order_counter);
 }
 
-int isPageAccessed(struct proc* p, int index){
-
-  pte_t* pte = walkpgdir(p->ram_manager[index].pgdir, (char*)(p->ram_manager[index].vAddr), 0);
-  return (*pte & PTE_A);
+static void update_arc(struct proc* p){
+  refs_of(p);
+  pp_tick_ARC(p->ram_manager, MAX_PSYC_PAGES, page_refbit);
+  p->lastcpu = 0;
 }
 
 /*
@@ -393,12 +426,10 @@ int acquire_pAddr(int vAddr, pde_t * pgdir){
 }
 
 /*
-* Change PTE flags properly after swapping-out vAddr
+* Change PTE flags properly after swapping-out vAddr, leaving the TLB refresh to the caller
 */
-void update_pageOUT_pte_flags(struct proc* p, int vAddr, pde_t * pgdir){
-  
-  // struct proc* p = myproc();
-  
+static void set_pageOUT_pte_flags(int vAddr, pde_t * pgdir){
+
   pte_t *pte = walkpgdir(pgdir, (int*)vAddr, 0);
   if (!pte)
     panic("update_pageOUT_pte_flags: pte does NOT exist in pgdir");
@@ -406,6 +437,16 @@ void update_pageOUT_pte_flags(struct proc* p, int vAddr, pde_t * pgdir){
   *pte |= PTE_PG;           // Inidicates that the page was Paged-out to secondary storage
   *pte &= ~PTE_P;           // Indicates that the page is NOT in physical memory
   *pte &= PTE_FLAGS(*pte);
+}
+
+/*
+* Change PTE flags properly after swapping-out vAddr
+*/
+void update_pageOUT_pte_flags(struct proc* p, int vAddr, pde_t * pgdir){
+  
+  // struct proc* p = myproc();
+  
+  set_pageOUT_pte_flags(vAddr, pgdir);
   
   lcr3(V2P(p->pgdir));      // Refresh CR3 register (TLB (cache))
 }
@@ -416,7 +457,16 @@ void update_pageOUT_pte_flags(struct proc* p, int vAddr, pde_t * pgdir){
 int is_page_in_file(struct proc* p, int vAddr) {
   pte_t *pte;
   pte = walkpgdir(p->pgdir, (char *)vAddr, 0);
-  return (*pte & PTE_PG);
+  return pte && (*pte & PTE_PG);
+}
+
+/*
+* Checks if page corresponding to vAddr was dropped by MADV_DONTNEED
+*/
+int is_zero_fill_page(struct proc* p, int vAddr) {
+  pte_t *pte;
+  pte = walkpgdir(p->pgdir, (char *)vAddr, 0);
+  return pte && !(*pte & PTE_P) && (*pte & PTE_ZF);
 }
 
 /*
@@ -443,25 +493,131 @@ int find_avail_index_in_ram_manger(struct proc* p) {
 */
 void add_page_to_ram(struct proc* p, pde_t *pgdir, uint vAddr) {
 
+  lockpagemap(p);
   int index = find_avail_index_in_ram_manger(p);
   p->ram_manager[index].state = USED;
   p->ram_manager[index].pgdir = pgdir;
   p->ram_manager[index].vAddr = vAddr;
   p->ram_manager[index].create_order = generate_creation_number(p);
 
-  // Initialize access_trackers of all pages on proc np to 0
-  int initValue = 0;
+  p->ram_manager[index].access_tracker = 0;
+  p->ram_manager[index].adv_queue = generate_adv_number(p);
+  p->ram_manager[index].cached = 0;
+  p->ram_manager[index].pinned = 0;
+  p->ram_manager[index].arc_list = 0;
+
+  struct page_policy *policy = proc_policy(p);
+  if(policy->on_insert)
+    policy->on_insert(p, index);
+  unlockpagemap(p);
+}
 
-  #if NFUA
-    initValue = 0;
-  #endif
+/*
+* Returns the index of vAddr in ram_manager, or -1 if it is not there
+*/
+int find_page_in_ram(struct proc* p, uint vAddr){
 
-  #if LAPA
-    initValue = 0xFFFFFFFF;
-  #endif
-  p->ram_manager[index].access_tracker = initValue;
+  for(int i=0; i < MAX_PSYC_PAGES; i++)
+    if(p->ram_manager[i].state == USED && p->ram_manager[i].vAddr == vAddr &&
+      p->ram_manager[i].pgdir == p->pgdir)
+      return i;
+  return -1;
+}
 
-  p->ram_manager[index].adv_queue = generate_adv_number(p);
+/*
+* Books a room in memory for the new page vAddr of p, swapping out a victim if memory is full.
+* Returns the index of vAddr in ram_manager, or -1 if p's pages are not managed.
+*/
+int track_page(struct proc* p, uint vAddr){
+
+  if(check_NONE_policy() || is_shell_or_init(p))
+    return -1;
+
+  if(find_avail_index_in_ram_manger(p) < 0)
+    swap(p, p->pgdir, vAddr); // evicts a victim and books vAddr in its place
+  else
+    add_page_to_ram(p, p->pgdir, vAddr);
+
+  return find_page_in_ram(p, vAddr);
+}
+
+/*
+* Takes page out of memory: page cache pages (see mmap.c) are just unmapped,
+* the others are written to place slot of the swapfile (any place if slot is -1).
+* Returns the frame to free once the TLB is refreshed, or 0.
+*/
+static char* unmap_page_out(struct proc* p, struct page_struct* page, int slot){
+
+  if(page->cached){
+    mmapdrop(p, page->vAddr);
+    return 0;
+  }
+
+  // Get the physical address mapped to the virtual address page->vAddr in page directory page->pgdir
+  int page_phys_addr = acquire_pAddr(page->vAddr, page->pgdir);
+
+  // Swap-out the page through its kernel address: page->pgdir need not be the current one
+  page_out(p, page->vAddr, page->pgdir, (char*)P2V(page_phys_addr), slot);
+
+  // Fix PTE flags properly after swapping-out vAddr
+  set_pageOUT_pte_flags(page->vAddr, page->pgdir);
+
+  return (char*)P2V(page_phys_addr);
+}
+
+static void evict_page(struct proc* p, struct page_struct* page){
+
+  char* mem = unmap_page_out(p, page, -1);
+
+  lcr3(V2P(p->pgdir));      // Refresh CR3 register (TLB (cache))
+
+  //free swapped-out page
+  if(mem)
+    kfree(mem);
+}
+
+/*
+* Swaps out up to n pages (at most SWAP_BATCH) in one go: the policy picks them all first,
+* they go to consecutive places in the swapfile, and the TLB is refreshed once for all of them.
+* Returns the number of rooms freed in memory.
+*/
+int swap_out_batch(struct proc* p, int n){
+
+  struct page_struct victims[SWAP_BATCH];
+  char* frames[SWAP_BATCH];
+  int i, k, slot;
+
+  if(n > SWAP_BATCH)
+    n = SWAP_BATCH;
+
+  lockswap(p);
+
+  // Freeing a victim's room right away keeps the policy from picking it again
+  lockpagemap(p);
+  for(k = 0; k < n; k++){
+    if((i = find_avail_page_index_to_swapout(p)) < 0)
+      break;
+    victims[k] = p->ram_manager[i];
+    p->ram_manager[i].state = NOT_USED;
+  }
+  unlockpagemap(p);
+
+  // No run of k free places: each page goes wherever there is room
+  slot = find_avail_run_in_file(p, k);
+
+  for(i = 0; i < k; i++){
+    frames[i] = unmap_page_out(p, &victims[i], slot < 0 ? -1 : slot + i);
+    p->paged_out_count++;
+  }
+
+  lcr3(V2P(p->pgdir));      // Refresh CR3 register (TLB (cache)) once for the whole batch
+
+  for(i = 0; i < k; i++)
+    if(frames[i])
+      kfree(frames[i]);
+
+  unlockswap(p);
+  return k;
 }
 
 
@@ -476,29 +632,25 @@ void swap(struct proc *p, pde_t *pgdir, uint vAddr){
   
   p->paged_out_count++;
 
+  lockswap(p);
+
   // Get the index of page in memory which should be swapped out according to the policy
+  lockpagemap(p);
   int page_index = find_avail_page_index_to_swapout(p);
-
-  // Get the physical address mapped to the virtual address p->ram_manager[page_index].vAddr in page directory p->ram_manager[page_index].pgdir
-  int page_phys_addr = acquire_pAddr(p->ram_manager[page_index].vAddr, p->ram_manager[page_index].pgdir);
-
-  // Swap-out page starting in p->ram_manager[page_index].vAddr
-  page_out(p, p->ram_manager[page_index].vAddr, p->ram_manager[page_index].pgdir);
-  
-  // Converts physical address to virtual address
-  char *va = (char*)P2V(page_phys_addr);
-  
-  //free swapped-out page
-  kfree(va);
+  struct page_struct outPage = p->ram_manager[page_index];
 
   // Change state of swapped-out page in MEMORY to UNUSED
   p->ram_manager[page_index].state = NOT_USED;
+  unlockpagemap(p);
+  trace(TR_SWAP, p, vAddr, outPage.vAddr);
 
-  // Fix PTE flags properly after swapping-out vAddr
-  update_pageOUT_pte_flags(p, p->ram_manager[page_index].vAddr, p->ram_manager[page_index].pgdir);
+  // Swap-out (or unmap) the page
+  evict_page(p, &outPage);
 
   // Finds an available page in memory and updates its virtual address to be vAddr
   add_page_to_ram(p, pgdir, vAddr);
+
+  unlockswap(p);
 }
 
 /*
@@ -520,196 +672,629 @@ void update_pageIN_pte_flags(struct proc* p, int vAddr, int pagePAddr, pde_t * p
   lcr3(V2P(p->pgdir)); //refresh CR3 register
 }
 
-static char buff[PGSIZE];
 /*
 * Reads a page corresponding to page_index from swapfile,
-* Allocates new room in physical memory for it and writes it into memory
+* Allocates new room in physical memory for it and writes it into memory.
+* The page is read straight into its new frame through the frame's kernel address,
+* so no bounce buffer is shared between CPUs faulting at the same time.
 */
 int swap_in(struct proc* p, int page_index){
 
-  // This buffer used to store swapped-in page temporary
+  struct page_struct outPage;
+  int evict = 0;
 
   p->page_fault_count++;
   int vAddr = PGROUNDDOWN(page_index);
+  p->scan_ptr = vAddr;
+  trace(TR_SWAPIN, p, vAddr, 0);
 
-  // Allocate new space in memory of page size for the swapping-in page
+  // Allocate new space in memory of page size for the swapping-in page (page_in fills all of it)
   char* new_allocated_page = kalloc();
 
-  // Initialize the allocated page in memory with 0
-  memset(new_allocated_page, 0, PGSIZE);
+  lockswap(p);
 
   // Find available page room in memory and return its index in array
+  lockpagemap(p);
   int avail_index_page_in_ram = find_avail_index_in_ram_manger(p);
 
-  // Refresh CR3 register to avoid non-updated address access from TLB
-  lcr3(V2P(p->pgdir));
-
-  // If there is a room for a new page in memory..
-  if (avail_index_page_in_ram >= 0) {
-    // Update PTE flags and map vAddr to the physical address new_allocated_page
-    update_pageIN_pte_flags(p, vAddr, V2P(new_allocated_page), p->pgdir);
-
-    // Find the relevant page (with vAddr) in swapfile, and write its content in the new allocated address in memory
-    page_in(p, avail_index_page_in_ram, vAddr, (char*)vAddr);
-
-    return 1; //Operation was successful
-  }
-  p->paged_out_count++;
-
   /*
-  * Swapping-out is needed
+  * No room left: swapping-out is needed
   */
+  if (avail_index_page_in_ram < 0) {
+    p->paged_out_count++;
+
+    // Find the page to swap out according to the policy, and take its room
+    avail_index_page_in_ram = find_avail_page_index_to_swapout(p);
+    outPage = p->ram_manager[avail_index_page_in_ram];
+    p->ram_manager[avail_index_page_in_ram].state = NOT_USED;
+    evict = 1;
+  }
+  unlockpagemap(p);
 
-  // Find the available page space in swapfile and return its index in array
-  avail_index_page_in_ram = find_avail_page_index_to_swapout(p);
-
-  struct page_struct outPage = p->ram_manager[avail_index_page_in_ram];
-
-  // Find the relevant page (with vAddr) in swapfile, and write its content in the new allocated address in memory
+  // Update PTE flags and map vAddr to the physical address new_allocated_page
   update_pageIN_pte_flags(p, vAddr, V2P(new_allocated_page), p->pgdir);
 
-  // Find the relevant page (with vAddr) in swapfile, and write its content on buff temporary
-  page_in(p, avail_index_page_in_ram, vAddr, buff);
+  // Find the relevant page (with vAddr) in swapfile, and write its content in the new allocated address in memory.
+  // The victim still has its own frame, so it can be written out afterwards (maybe to the place just read).
+  page_in(p, avail_index_page_in_ram, vAddr, new_allocated_page);
 
-  // Get the corresponding physical address of outPage.vAddr
-  int outPagePAddr = acquire_pAddr(outPage.vAddr, outPage.pgdir);
+  // Write the swapped-out page from memory to swapfile (or just unmap it) and free it
+  if (evict)
+    evict_page(p, &outPage);
 
-  // Writes buff into new_allocated_page, in other words reads the page from swapfile to physical memory
-  memmove(new_allocated_page, buff, PGSIZE);
+  lockpagemap(p);
+  if(proc_policy(p)->on_fault)
+    proc_policy(p)->on_fault(p, avail_index_page_in_ram);
+  unlockpagemap(p);
 
-  // Write the swapped-out page from memory to swapfile
-  page_out(p, outPage.vAddr, outPage.pgdir);
+  unlockswap(p);
+  return 1; //Operation was successful
+}
 
-  // Update outPage.vAddr PTE flags for proper to swapping-out
-  update_pageOUT_pte_flags(p, outPage.vAddr, outPage.pgdir);
+/*
+* LAPA counts the accesses of a page, so a new page starts as if it was accessed on every tick
+*/
+static void init_page_by_LAPA(struct proc* p, int index){
+  p->ram_manager[index].access_tracker = 0xFFFFFFFF;
+}
 
-  // Get the corresponding physical address of the swapped-out page's virtual address
-  char *v = (char*)P2V(outPagePAddr);
+/*
+* The replacement policies, indexed by POLICY_* (see policy.h)
+*/
+static struct page_policy policies[NPOLICY] = {
+[POLICY_NFUA]   { "NFUA",   find_avail_index_by_NFUA,   update_access_trackers, 0,                 0 },
+[POLICY_LAPA]   { "LAPA",   find_avail_index_by_LAPA,   update_access_trackers, init_page_by_LAPA, 0 },
+[POLICY_SCFIFO] { "SCFIFO", find_avail_index_by_SCFIFO, 0,                      0,                 0 },
+[POLICY_AQ]     { "AQ",     find_avail_index_by_AQ,     update_adv_queues,      0,                 0 },
+[POLICY_ARC]    { "ARC",    find_avail_index_by_ARC,    update_arc,             admit_page_by_ARC, admit_page_by_ARC },
+};
 
-  // Free the memory space of the swapped-out page
-  kfree(v);
+/*
+* The policy of processes that did not choose one, set at build time by SELECTION
+*/
+#if LAPA
+int default_policy = POLICY_LAPA;
+#elif SCFIFO
+int default_policy = POLICY_SCFIFO;
+#elif AQ
+int default_policy = POLICY_AQ;
+#elif ARC
+int default_policy = POLICY_ARC;
+#else
+int default_policy = POLICY_NFUA;
+#endif
 
-  return 1;
+/*
+* Returns the replacement policy p is using
+*/
+struct page_policy* proc_policy(struct proc* p){
+
+  return &policies[p->curpolicy];
 }
 
 /*
-* Checks if a policy was defined or not
+* A new process follows the default policy
 */
-int check_NONE_policy(void){
-  #if NONE
-    return 1;
-  #endif
-  return 0;
+void init_policy(struct proc* p){
+
+  p->policy = POLICY_DEFAULT;
+  p->curpolicy = default_policy;
+  memset(&p->arc, 0, sizeof(p->arc));
 }
 
 /*
-* Updates the accessCouter field of all used pages of process p,
-* according to their PTE_A flag (which turned on when access to page ocurred)
+* A policy keeps its bookkeeping (aging trackers, ARC lists and ghosts) only while a process
+* uses it, so a process whose p->policy (or the default it follows) now names another one
+* starts that afresh: its resident pages are entered again, oldest first, as if they had
+* just come in. p->curpolicy changes in the same critical section, so no tick or fault runs
+* the new policy on the old one's bookkeeping. Caller holds lockpagemap(p).
 */
-void update_access_trackers(struct proc* p){
-  pte_t * pte;
-  int i;
-  for (i = 0; i < MAX_PSYC_PAGES; i++) {
-    if (p->ram_manager[i].state == USED){
-      pte = walkpgdir(p->ram_manager[i].pgdir, (char*)p->ram_manager[i].vAddr,0);
-      
-      p->ram_manager[i].access_tracker = p->ram_manager[i].access_tracker >> 1; // shift right by 1
-      if(*pte & PTE_A){
-        
-        *pte &= ~PTE_A; // turn off PTE_A flag
-        p->ram_manager[i].access_tracker |= 0x80000000; // add bit 1 to MSB
-      }
-      else{
-        p->ram_manager[i].access_tracker &= 0x7FFFFFFF;
-      }
-    } 
+void restart_policy(struct proc* p){
+
+  struct page_policy *policy;
+  uint seeded = 0;
+  int i, next, cur;
+
+  cur = p->policy == POLICY_DEFAULT ? default_policy : p->policy;
+  if(cur == p->curpolicy)
+    return;
+  p->curpolicy = cur;
+  policy = proc_policy(p);
+
+  memset(&p->arc, 0, sizeof(p->arc));
+  for(;;){
+    next = -1;
+    for(i = 0; i < MAX_PSYC_PAGES; i++)
+      if(p->ram_manager[i].state == USED && !(seeded & (1 << i)) &&
+         (next < 0 || p->ram_manager[i].create_order < p->ram_manager[next].create_order))
+        next = i;
+    if(next < 0)
+      break;
+    seeded |= 1 << next;
+    p->ram_manager[next].access_tracker = 0;
+    p->ram_manager[next].arc_list = 0;
+    if(policy->on_insert)
+      policy->on_insert(p, next);
   }
 }
 
+/*
+* setpolicy(): sets the replacement policy of p (or the system-wide default, if global),
+* and restarts it in the processes whose policy that changes (see restart_policy).
+* Returns the previous policy, or -1.
+* Without paging (SELECTION=NONE) there is nothing to choose.
+*/
+int setpolicy(struct proc* p, int policy, int global){
+
+  int old;
 
+  if(check_NONE_policy() || policy < 0 || policy >= NPOLICY)
+    return -1;
+
+  if(global){
+    if(policy == POLICY_DEFAULT)
+      return -1;
+    old = default_policy;
+    default_policy = policy;
+    if(policy != old)
+      restart_default_policy();
+    return old;
+  }
+
+  lockpagemap(p);
+  old = p->policy;
+  p->policy = policy;
+  restart_policy(p);
+  unlockpagemap(p);
+  return old;
+}
+
+/*
+* Checks if a policy was defined or not
+*/
+int check_NONE_policy(void){
+  #if NONE
+    return 1;
+  #endif
+  return 0;
+}
+
+/*
+* Updates the accessCouter field of all used pages of process p,
+* according to their PTE_A flag (which turned on when access to page ocurred)
+*/
+void update_access_trackers(struct proc* p){
+
+  refs_of(p);
+  pp_age(p->ram_manager, MAX_PSYC_PAGES, page_refbit);
+
+  // A TLB that still caches these pages would not set PTE_A again,
+  // so make the scheduler reload %cr3 next time p runs.
+  p->lastcpu = 0;
+}
+
+/*
+* Advances the accessed pages of process p in the AQ queue
+*/
 void update_adv_queues(struct proc* p){
-  
-  int priorPageIndex = -1;
-  int afterPageIndex = -1;
+
+  refs_of(p);
+  pp_advance(p->ram_manager, MAX_PSYC_PAGES, page_refbit);
+  p->lastcpu = 0;
+}
+
+
+/*
+* Returns the madvise() hint covering vAddr (the newest matching range wins)
+*/
+int page_advice(struct proc* p, uint vAddr){
+
+  for(int n = 1; n <= NMADV; n++){
+    struct madv_range *r = &p->madv[(p->madv_next - n + NMADV) % NMADV];
+    if(r->start <= vAddr && vAddr < r->end)
+      return r->advice;
+  }
+  return MADV_NORMAL;
+}
+
+/*
+* Picks a victim according to the process' madvise() hints, regardless of the policy:
+* MADV_COLD pages first, then MADV_SEQUENTIAL pages that are already behind the
+* scan pointer (the furthest behind first). Returns -1 if no resident page is hinted.
+*/
+int find_hinted_victim(struct proc* p){
+
+  int cold = -1;
+  int seq = -1;
 
   for(int i=0; i < MAX_PSYC_PAGES; i++){
-    if(p->ram_manager[i].state == NOT_USED)
+    if(p->ram_manager[i].state == NOT_USED || p->ram_manager[i].pinned)
       continue;
 
-    if(priorPageIndex == -1){ // If this is the first page in ram we meet
-      
-      priorPageIndex = findNextAQPageIndex(p, priorPageIndex);
-    }
-    else{
-      afterPageIndex = findNextAQPageIndex(p, priorPageIndex);
-      if(isPageAccessed(p, afterPageIndex) &&
-        !isPageAccessed(p, priorPageIndex)){
+    uint vAddr = p->ram_manager[i].vAddr;
+    int advice = page_advice(p, vAddr);
+    if(advice == MADV_COLD && cold == -1)
+      cold = i;
+    if(advice == MADV_SEQUENTIAL && vAddr < PGROUNDDOWN(p->scan_ptr) &&
+      (seq == -1 || vAddr < p->ram_manager[seq].vAddr))
+      seq = i;
+  }
 
-        swap_adv_queue(p, afterPageIndex, priorPageIndex);
-      }
+  return cold >= 0 ? cold : seq;
+}
 
-      priorPageIndex = afterPageIndex;
-    }
+/*
+* Maps a fresh zeroed page at vAddr, which was dropped by MADV_DONTNEED.
+* Makes room in memory first if the process is at MAX_PSYC_PAGES.
+*/
+int zero_fill_in(struct proc* p, int vAddr){
+
+  vAddr = PGROUNDDOWN(vAddr);
+  pte_t *pte = walkpgdir(p->pgdir, (char*)vAddr, 0);
+  if(!pte || (*pte & PTE_P) || !(*pte & PTE_ZF))
+    return 0;
+
+  char *mem = kalloc();
+  if(mem == 0)
+    return 0;
+  memset(mem, 0, PGSIZE);
+
+  p->scan_ptr = vAddr;
+  track_page(p, vAddr);
+
+  *pte = V2P(mem) | PTE_P | PTE_W | PTE_U;
+  lcr3(V2P(p->pgdir));
+  return 1;
+}
+
+/*
+* Drops the page at vAddr: frees its frame or its swapfile slot, and leaves a
+* PTE that zero-fills on the next touch.
+*/
+static void dontneed_page(struct proc* p, uint vAddr){
+
+  pte_t *pte = walkpgdir(p->pgdir, (char*)vAddr, 0);
+  if(!pte)
+    return;
+
+  if(*pte & PTE_P){
+    kfree(P2V(PTE_ADDR(*pte)));
+    remove_page_from_ram(p, vAddr, p->pgdir);
   }
+  else if(*pte & PTE_PG)
+    remove_page_from_file(p, vAddr, p->pgdir);
+  else
+    return;
+
+  *pte = PTE_ZF | PTE_W | PTE_U;
 }
 
+/*
+* Reads the swapped-out page at vAddr back into a free room in memory, as swap_in
+* does but without evicting anything. Returns 0 if there is no free room (or the
+* page could not be read). Caller holds lockswap(p).
+*/
+static int willneed_page(struct proc* p, uint vAddr){
 
-// Allocate page tables and physical memory to grow process from oldsz to
-// newsz, which need not be page aligned.  Returns new size or 0 on error.
-int
-allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
-{
-  char *mem;
+  if(!is_page_in_file(p, vAddr))
+    return 1;
+
+  char *mem = kalloc();
+  if(mem == 0)
+    return 0;
+
+  lockpagemap(p);
+  int index = find_avail_index_in_ram_manger(p);
+  unlockpagemap(p);
+  if(index < 0 || page_in(p, index, vAddr, mem) < 0){
+    kfree(mem);
+    return 0;
+  }
+
+  // Map it only now that it holds the page
+  update_pageIN_pte_flags(p, vAddr, V2P(mem), p->pgdir);
+
+  lockpagemap(p);
+  if(proc_policy(p)->on_fault)
+    proc_policy(p)->on_fault(p, index);
+  unlockpagemap(p);
+  return 1;
+}
+
+/*
+* madvise(): applies advice to the user pages overlapping addr..addr+len.
+* DONTNEED and WILLNEED act right away (there are no kernel threads to read
+* ahead in the background, so WILLNEED prefetches synchronously, as far as
+* the free rooms in memory allow). The other hints are remembered and used
+* by find_hinted_victim().
+*/
+int madvise(struct proc* p, uint addr, uint len, int advice){
+
+  uint start = PGROUNDDOWN(addr);
+  uint end = PGROUNDUP(addr + len);
   uint a;
-  struct proc* p = myproc();
 
-  if(newsz >= KERNBASE)
+  if(end < start || end > p->sz)
+    return -1;
+
+  switch(advice){
+  case MADV_NORMAL:
+  case MADV_RANDOM:
+  case MADV_SEQUENTIAL:
+  case MADV_COLD:
+    p->madv[p->madv_next].start = start;
+    p->madv[p->madv_next].end = end;
+    p->madv[p->madv_next].advice = advice;
+    p->madv_next = (p->madv_next + 1) % NMADV;
     return 0;
-  if(newsz < oldsz)
-    return oldsz;
 
-  // If any policy is defined..
-  if (!check_NONE_policy()){
-    // If number of pages composing newsz exceeds MAX_TOTAL_PAGES and the current proc is NOT init or shell...
-    if (PGROUNDUP(newsz)/PGSIZE > MAX_TOTAL_PAGES && !is_shell_or_init(p)) {
+  case MADV_DONTNEED:
+    lockswap(p);
+    for(a = start; a < end; a += PGSIZE)
+      dontneed_page(p, a);
+    lcr3(V2P(p->pgdir));
+    unlockswap(p);
+    return 0;
+
+  case MADV_WILLNEED:
+    if(check_NONE_policy() || is_shell_or_init(p))
       return 0;
+    lockswap(p);
+    for(a = start; a < end; a += PGSIZE)
+      if(!willneed_page(p, a))
+        break;
+    unlockswap(p);
+    return 0;
+  }
+
+  return -1;
+}
+
+/*
+* Makes the user page at vAddr resident, the way the page fault handler would
+*/
+static int fault_in_page(struct proc* p, uint vAddr){
+
+  pte_t *pte = walkpgdir(p->pgdir, (char*)vAddr, 0);
+  if(pte && (*pte & PTE_P))
+    return 1;
+  if(is_page_in_file(p, vAddr))
+    return swap_in(p, vAddr);
+  if(is_zero_fill_page(p, vAddr))
+    return zero_fill_in(p, vAddr);
+  if(growstack(p, vAddr))
+    return 1;
+  return mmapfault(p, vAddr, 0);
+}
+
+/*
+* mlock(): brings the pages overlapping addr..addr+len into memory and pins them there,
+* so that no policy picks them for swapping out. At most MAX_LOCKED_PAGES pages of a
+* process are pinned at a time, so that there is always a victim left.
+* Huge pages are never swapped out and need no pinning.
+*/
+int mlock(struct proc* p, uint addr, uint len){
+
+  uint start = PGROUNDDOWN(addr);
+  uint end = PGROUNDUP(addr + len);
+  uint a;
+  int i, count = 0;
+
+  if(end < start)
+    return -1;
+
+  // Pages of shell and init (or of any process without a policy) are never swapped out
+  if(check_NONE_policy() || is_shell_or_init(p)){
+    for(a = start; a < end; a += PGSIZE)
+      if(!(a >= HUGEBASE && a < HUGETOP) && !fault_in_page(p, a))
+        return -1;
+    return 0;
+  }
+
+  for(i=0; i < MAX_PSYC_PAGES; i++)
+    if(p->ram_manager[i].state == USED && (p->ram_manager[i].pinned & PIN_MLOCK))
+      count++;
+  for(a = start; a < end; a += PGSIZE){
+    if(a >= HUGEBASE && a < HUGETOP)
+      continue;
+    i = find_page_in_ram(p, a);
+    if(i < 0 || !(p->ram_manager[i].pinned & PIN_MLOCK))
+      count++;
+  }
+  if(count > MAX_LOCKED_PAGES)
+    return -1;
+
+  // Pin each page as soon as it is in, so that bringing in the next one can not evict it
+  for(a = start; a < end; a += PGSIZE){
+    if(a >= HUGEBASE && a < HUGETOP)
+      continue;
+    if(!fault_in_page(p, a))
+      return -1;
+    lockpagemap(p);
+    if((i = find_page_in_ram(p, a)) >= 0)
+      p->ram_manager[i].pinned |= PIN_MLOCK;
+    unlockpagemap(p);
+  }
+  return 0;
+}
+
+/*
+* munlock(): lets the pages overlapping addr..addr+len be swapped out again
+*/
+int munlock(struct proc* p, uint addr, uint len){
+
+  uint start = PGROUNDDOWN(addr);
+  uint end = PGROUNDUP(addr + len);
+  int i;
+
+  if(end < start)
+    return -1;
+
+  lockpagemap(p);
+  for(uint a = start; a < end; a += PGSIZE)
+    if((i = find_page_in_ram(p, a)) >= 0)
+      p->ram_manager[i].pinned &= ~PIN_MLOCK;
+  unlockpagemap(p);
+  return 0;
+}
+
+/*
+* iopin(): brings the system call buffer addr..addr+n of p into memory and pins it there
+* until iounpin(), so that the kernel can copy to or from it while it holds a sleeplock
+* or is in a log transaction, where a page fault is not served (see trap.c).
+* At most MAX_IO_PAGES pages are pinned so at a time, on top of the mlock()ed ones.
+*/
+int iopin(struct proc* p, uint addr, uint n){
+
+  uint a;
+  int i, count = 0;
+  pte_t *pte;
+
+  for(i=0; i < MAX_PSYC_PAGES; i++)
+    if(p->ram_manager[i].state == USED && (p->ram_manager[i].pinned & PIN_IO))
+      count++;
+
+  for(a = PGROUNDDOWN(addr); a < addr + n; a += PGSIZE){
+    if(a >= HUGEBASE && a < HUGETOP)
+      continue;
+    if(a >= MMAPBASE && a < MMAPTOP)
+      mmapfaultin(p, a, PGSIZE);
+    else if(!fault_in_page(p, a))
+      return -1;
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0 || !(*pte & PTE_P))
+      return -1;
+    if(check_NONE_policy() || is_shell_or_init(p))
+      continue;   // never swapped out
+
+    // Pin it at once, so that bringing in the next page can not evict it
+    lockpagemap(p);
+    if((i = find_page_in_ram(p, a)) >= 0 && !(p->ram_manager[i].pinned & PIN_IO)){
+      if(count == MAX_IO_PAGES){
+        unlockpagemap(p);
+        return -1;
+      }
+      p->ram_manager[i].pinned |= PIN_IO;
+      count++;
     }
+    unlockpagemap(p);
   }
+  return 0;
+}
 
+/*
+* Lets the pages pinned by iopin() be swapped out again
+*/
+void iounpin(struct proc* p){
+
+  lockpagemap(p);
+  for(int i=0; i < MAX_PSYC_PAGES; i++)
+    p->ram_manager[i].pinned &= ~PIN_IO;
+  unlockpagemap(p);
+}
 
-  a = PGROUNDUP(oldsz);
+// Map zeroed pages over [start, end) of pgdir, start page aligned,
+// and enter them in the paging of the current process.  On error
+// unmaps them again and returns -1.
+static int
+allocrange(pde_t *pgdir, uint start, uint end)
+{
+  char *mem;
+  uint a;
+  struct proc* p = myproc();
 
-  int addPages = 0;
-  for(; a < newsz; a += PGSIZE){
+  for(a = start; a < end; a += PGSIZE){
     
     mem = kalloc();
-    addPages++;
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
-      deallocuvm(pgdir, newsz, oldsz);
-      return 0;
+      deallocuvm(pgdir, end, start);
+      return -1;
     }
     memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
-      deallocuvm(pgdir, newsz, oldsz);
+      deallocuvm(pgdir, end, start);
       kfree(mem);
-      return 0;
+      return -1;
     }
 
     // If any policy is defined AND current proc is NOT init or shell...
     if (!check_NONE_policy() && !is_shell_or_init(p)){
-      // If current proc cannot have more pages in memory (exceeds MAX_PSYC_PAGES)
-      if (PGROUNDUP(oldsz)/PGSIZE + addPages > MAX_PSYC_PAGES)
-        swap(p, pgdir, a);
-      else //there's room
-        add_page_to_ram(p, pgdir, a);
+      // If current proc cannot have more pages in memory (exceeds MAX_PSYC_PAGES),
+      // make room for as many of the pages still to come as one batch allows
+      if (find_avail_index_in_ram_manger(p) < 0 &&
+          swap_out_batch(p, (PGROUNDUP(end) - a)/PGSIZE) == 0){
+        cprintf("allocuvm out of memory (3)\n");
+        deallocuvm(pgdir, end, start);
+        return -1;
+      }
+      add_page_to_ram(p, pgdir, a);
+    }
+  }
+
+  return 0;
+}
+
+// Allocate page tables and physical memory to grow process from oldsz to
+// newsz, which need not be page aligned.  Returns new size or 0 on error.
+int
+allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  struct proc* p = myproc();
+
+  if(newsz >= KERNBASE)
+    return 0;
+  if(newsz < oldsz)
+    return oldsz;
+
+  // If any policy is defined..
+  if (!check_NONE_policy()){
+    // If number of pages composing newsz (and the stack) exceeds MAX_TOTAL_PAGES and the current proc is NOT init or shell...
+    uint stacksz = (pgdir == p->pgdir) ? p->stacksz : 0;
+    if ((PGROUNDUP(newsz) + stacksz)/PGSIZE > MAX_TOTAL_PAGES && !is_shell_or_init(p)) {
+      return 0;
     }
   }
 
+  if(allocrange(pgdir, PGROUNDUP(oldsz), newsz) < 0)
+    return 0;
+
   return newsz;
 }
 
+// Grow the user stack of pgdir from oldsz to newsz bytes below
+// STACKTOP (newsz is rounded up to a page).  Returns new size or 0.
+int
+allocstack(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  newsz = PGROUNDUP(newsz);
+  if(newsz > MAXSTACK*PGSIZE || newsz < oldsz)
+    return 0;
+  if(allocrange(pgdir, STACKTOP - newsz, STACKTOP - oldsz) < 0)
+    return 0;
+  return newsz;
+}
+
+// A user fault at va below the stack of p, within MAXSTACK pages of
+// STACKTOP: grow the stack down over va.  The new pages take part in
+// paging like heap pages, and count towards MAX_TOTAL_PAGES.
+// Returns 1 if va is mapped now.
+int
+growstack(struct proc *p, uint va)
+{
+  uint newsz = STACKTOP - PGROUNDDOWN(va);
+
+  if(va >= STACKTOP - p->stacksz || va < STACKTOP - MAXSTACK*PGSIZE)
+    return 0;
+  if(!check_NONE_policy() && !is_shell_or_init(p) &&
+     (PGROUNDUP(p->sz) + newsz)/PGSIZE > MAX_TOTAL_PAGES)
+    return 0;
+  if(allocstack(p->pgdir, p->stacksz, newsz) == 0)
+    return 0;
+  p->stacksz = newsz;
+  return 1;
+}
+
 
 void remove_page_from_ram(struct proc* p, uint vAddr, pde_t *pgdir){
   
@@ -717,11 +1302,28 @@ void remove_page_from_ram(struct proc* p, uint vAddr, pde_t *pgdir){
     return;
 
   int i;
+  lockpagemap(p);
   for (i = 0; i < MAX_PSYC_PAGES; i++) {
     if (p->ram_manager[i].state == USED 
         && p->ram_manager[i].vAddr == vAddr
         && p->ram_manager[i].pgdir == pgdir){
       p->ram_manager[i].state = NOT_USED;
+      break;
+    }
+  }
+  unlockpagemap(p);
+}
+
+/*
+* Frees the room of the swapped-out page vAddr in the swapfile
+*/
+void remove_page_from_file(struct proc* p, uint vAddr, pde_t *pgdir){
+
+  for (int i = 0; i < MAX_FILE_PAGES; i++) {
+    if (p->file_manager[i].state == USED
+        && p->file_manager[i].vAddr == vAddr
+        && p->file_manager[i].pgdir == pgdir){
+      p->file_manager[i].state = NOT_USED;
       return;
     }
   }
@@ -751,6 +1353,12 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(*pte & PTE_PS){
+      // A whole 4 MB page from allochuge().
+      kfreehuge(P2V(PTE_ADDR(*pte)));
+      *pte = 0;
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    }
     else if((*pte & PTE_P) != 0){
       pa = PTE_ADDR(*pte);
       if(pa == 0)
@@ -766,6 +1374,47 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   return newsz;
 }
 
+// Map 4 MB pages for the huge-page region, growing it from
+// oldsz to newsz bytes above HUGEBASE (newsz is rounded up to
+// 4 MB).  The frames come from the kallochuge() pool.
+// Huge pages stay resident: they are never entered in ram_manager,
+// so the replacement policy never picks them, and a 4 MB unit does
+// not fit in the per-process swap file.  Returns new size or 0.
+int
+allochuge(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  uint a;
+  char *mem;
+
+  newsz = (newsz + PGSIZE4M - 1) & ~(PGSIZE4M - 1);
+  if(newsz > HUGETOP - HUGEBASE || newsz < oldsz)
+    return 0;
+  for(a = oldsz; a < newsz; a += PGSIZE4M){
+    if((mem = kallochuge()) == 0){
+      deallochuge(pgdir, a, oldsz);
+      return 0;
+    }
+    memset(mem, 0, PGSIZE4M);
+    // Drop an empty page table left behind by a split copy.
+    if(pgdir[PDX(HUGEBASE + a)] & PTE_P)
+      kfree(P2V(PTE_ADDR(pgdir[PDX(HUGEBASE + a)])));
+    pgdir[PDX(HUGEBASE + a)] = V2P(mem) | PTE_P | PTE_W | PTE_U | PTE_PS;
+  }
+  return newsz;
+}
+
+// Shrink the huge-page region from oldsz to newsz bytes
+// (rounded up to 4 MB).  Returns the new size.
+int
+deallochuge(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  newsz = (newsz + PGSIZE4M - 1) & ~(PGSIZE4M - 1);
+  if(newsz >= oldsz)
+    return oldsz;
+  deallocuvm(pgdir, HUGEBASE + oldsz, HUGEBASE + newsz);
+  return newsz;
+}
+
 // Free a page table and all the physical memory pages
 // in the user part.
 void
@@ -776,8 +1425,9 @@ freevm(pde_t *pgdir)
   if(pgdir == 0)
     panic("freevm: no pgdir");
   deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
-    if(pgdir[i] & PTE_P){
+  // Page-table pages above KERNBASE belong to kpgdir.
+  for(i = 0; i < PDX(KERNBASE); i++){
+    if((pgdir[i] & PTE_P) && !(pgdir[i] & PTE_PS)){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
     }
@@ -798,28 +1448,64 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
-// Given a parent process's page table, create a copy
-// of it for a child.
-pde_t*
-copyuvm(pde_t *pgdir, uint sz)
+// Copy the huge-page region (hugesz bytes at HUGEBASE) from
+// pgdir to d.  Each 4 MB page gets a fresh 4 MB frame; if the pool
+// has run dry, the child gets the same contents in 4 KB pages.
+static int
+copyhuge(pde_t *pgdir, pde_t *d, uint hugesz)
 {
-  struct proc* p = myproc();
-  if(p == 0)
-    return 0;
-
-  pde_t *d;
+  uint a, off, pa;
   pte_t *pte;
+  char *mem;
+
+  for(a = HUGEBASE; a < HUGEBASE + hugesz; a += PGSIZE4M){
+    if(pgdir[PDX(a)] & PTE_PS){
+      pa = PTE_ADDR(pgdir[PDX(a)]);
+      if((mem = kallochuge()) != 0){
+        memmove(mem, P2V(pa), PGSIZE4M);
+        d[PDX(a)] = V2P(mem) | PTE_FLAGS(pgdir[PDX(a)]);
+        continue;
+      }
+    }
+    // 4 KB pages: split from a 4 MB page, or already split.
+    for(off = 0; off < PGSIZE4M; off += PGSIZE){
+      if((pte = walkpgdir(pgdir, (void*)(a + off), 0)) == 0 ||
+         !(*pte & PTE_P))
+        continue;
+      if(*pte & PTE_PS)
+        pa = PTE_ADDR(*pte) + off;
+      else
+        pa = PTE_ADDR(*pte);
+      if((mem = kalloc()) == 0)
+        return -1;
+      memmove(mem, P2V(pa), PGSIZE);
+      if(mappages(d, (void*)(a + off), PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+        kfree(mem);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Copy the pages over [start, end) of pgdir into d.
+static int
+copyrange(pde_t *pgdir, pde_t *d, uint start, uint end)
+{
+  pte_t *pte, *cpte;
   uint pa, i, flags;
   char *mem;
 
-  if((d = setupkvm()) == 0)
-    return 0;
-  for(i = 0; i < sz; i += PGSIZE){
+  for(i = start; i < end; i += PGSIZE){
     if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
       panic("copyuvm: pte should exist");
     
-    if (*pte & PTE_PG){
-      update_pageOUT_pte_flags(p, i, d);
+    // Swapped out (the swapfile is cloned by fork) or dropped by
+    // MADV_DONTNEED (the child zero-fills it too): same PTE in the child.
+    if (!(*pte & PTE_P) && (*pte & (PTE_PG | PTE_ZF))){
+      if((cpte = walkpgdir(d, (void *) i, 1)) == 0)
+        return -1;
+      *cpte = *pte;
       continue;
     }
 
@@ -831,11 +1517,35 @@ copyuvm(pde_t *pgdir, uint sz)
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
-      goto bad;
+      return -1;
     memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0)
-      goto bad;
+    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0){
+      kfree(mem);
+      return -1;
+    }
   }
+  return 0;
+}
+
+// Given a parent process's page table, create a copy
+// of it for a child.
+pde_t*
+copyuvm(pde_t *pgdir, uint sz)
+{
+  struct proc* p = myproc();
+  if(p == 0)
+    return 0;
+
+  pde_t *d;
+
+  if((d = setupkvm()) == 0)
+    return 0;
+  if(copyrange(pgdir, d, 0, sz) < 0)
+    goto bad;
+  if(copyrange(pgdir, d, STACKTOP - p->stacksz, STACKTOP) < 0)
+    goto bad;
+  if(copyhuge(pgdir, d, p->hugesz) < 0)
+    goto bad;
   return d;
 
 bad:
@@ -851,10 +1561,12 @@ uva2ka(pde_t *pgdir, char *uva)
   pte_t *pte;
 
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
+  if(*pte & PTE_PS)
+    return (char*)P2V(PTE_ADDR(*pte)) + ((uint)uva & (PGSIZE4M-1) & ~(PGSIZE-1));
   return (char*)P2V(PTE_ADDR(*pte));
 }
 
@@ -0,0 +1,58 @@
+// The vmstat device: a snapshot of the paging statistics on every
+// read (see vmstat.h), so a monitor can poll it as often as it
+// likes without stopping the machine the way ^P does.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "vmstat.h"
+
+static int
+vmstatread(struct inode *ip, char *dst, int n)
+{
+  struct vmstat *st;
+  int max;
+
+  if(n < sizeof(*st))
+    return -1;
+  if((st = kmalloc(PGSIZE)) == 0)
+    return -1;
+  iunlock(ip);
+
+  max = (PGSIZE - sizeof(*st)) / sizeof(struct vmproc);
+  if((n - sizeof(*st)) / sizeof(struct vmproc) < max)
+    max = (n - sizeof(*st)) / sizeof(struct vmproc);
+
+  st->totalpages = getTotalPages();
+  st->freepages = getFreePages();
+  st->kallocfail = getFailedAllocs();
+  st->swappooled = pooledSwapFiles();
+  procvmstat(st, (struct vmproc*)(st + 1), max);
+
+  // The copy to user memory may fault, so no spinlock is held.
+  n = sizeof(*st) + st->nproc * sizeof(struct vmproc);
+  memmove(dst, st, n);
+  kmfree(st);
+
+  ilock(ip);
+  return n;
+}
+
+static int
+vmstatwrite(struct inode *ip, char *src, int n)
+{
+  return -1;
+}
+
+void
+vmstatinit(void)
+{
+  devsw[VMSTAT].read = vmstatread;
+  devsw[VMSTAT].write = vmstatwrite;
+}
@@ -0,0 +1,102 @@
+// Report paging statistics from the vmstat device (see vmstat.h):
+//
+//   vmstat                     memory, swap and every process
+//   vmstat seconds [count]     one line of rates every so many seconds
+//
+// The device gives a fresh snapshot on every read, so sampling it
+// is cheap and does not stop the machine.
+
+#include "types.h"
+#include "stat.h"
+#include "fcntl.h"
+#include "user.h"
+#include "param.h"
+#include "policy.h"
+#include "vmstat.h"
+
+#define BUFSZ 4096
+
+static char *policies[] = {
+[POLICY_DEFAULT] "default",
+[POLICY_NFUA]    "NFUA",
+[POLICY_LAPA]    "LAPA",
+[POLICY_SCFIFO]  "SCFIFO",
+[POLICY_AQ]      "AQ",
+[POLICY_ARC]     "ARC",
+};
+
+static int fd;
+
+static struct vmstat*
+snapshot(char *buf)
+{
+  if(read(fd, buf, BUFSZ) < (int)sizeof(struct vmstat)){
+    printf(2, "vmstat: cannot read vmstat\n");
+    exit();
+  }
+  return (struct vmstat*)buf;
+}
+
+static void
+report(void)
+{
+  char *buf = malloc(BUFSZ);
+  struct vmstat *st = snapshot(buf);
+  struct vmproc *vp = (struct vmproc*)(st + 1);
+  int i;
+
+  printf(1, "frames:     %d free of %d, %d failed allocations\n",
+         st->freepages, st->totalpages, st->kallocfail);
+  printf(1, "swap:       %d of %d places used, %d files pooled\n",
+         st->swapused, st->swapslots, st->swappooled);
+  printf(1, "paging:     %d faults, %d page-outs\n", st->faults, st->pageouts);
+  printf(1, "policy:     %d ticks (vmstat 1 shows their cost)\n", st->policyticks);
+  printf(1, "\npid\tpolicy\tsize\tram\tswap\tfaults\tpgouts\tname\n");
+  for(i = 0; i < st->nproc; i++, vp++)
+    printf(1, "%d\t%s\t%d\t%d\t%d\t%d\t%d\t%s\n", vp->pid,
+           vp->policy >= 0 && vp->policy < NPOLICY ? policies[vp->policy] : "?",
+           vp->size, vp->resident, vp->swapped, vp->faults, vp->pageouts, vp->name);
+  free(buf);
+}
+
+static void
+sample(int secs, int count)
+{
+  char *buf[2];
+  struct vmstat *old, *new;
+  int i, ticks;
+
+  buf[0] = malloc(BUFSZ);
+  buf[1] = malloc(BUFSZ);
+  old = snapshot(buf[0]);
+  for(i = 0; count == 0 || i < count; i++){
+    sleep(secs * TICKHZ);
+    new = snapshot(buf[(i+1) % 2]);
+    if(i % 20 == 0)
+      printf(1, "free\tfaults\tpgouts\tswap\tkfail\tpticks\tpcyc/tick\n");
+    ticks = new->policyticks - old->policyticks;
+    printf(1, "%d\t%d\t%d\t%d\t%d\t%d\t%d\n", new->freepages,
+           new->faults - old->faults, new->pageouts - old->pageouts,
+           new->swapused, new->kallocfail - old->kallocfail, ticks,
+           ticks ? (new->policycycles - old->policycycles) / ticks : 0);
+    old = new;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  if((fd = open("vmstat", O_RDONLY)) < 0){
+    mknod("vmstat", VMSTAT, 0);
+    if((fd = open("vmstat", O_RDONLY)) < 0){
+      printf(2, "vmstat: cannot open vmstat\n");
+      exit();
+    }
+  }
+
+  if(argc < 2)
+    report();
+  else
+    sample(atoi(argv[1]) > 0 ? atoi(argv[1]) : 1, argc > 2 ? atoi(argv[2]) : 0);
+  exit();
+}
@@ -0,0 +1,29 @@
+// Paging statistics, read from the vmstat device (vmdev.c): each read
+// returns a struct vmstat followed by nproc struct vmproc.
+
+#define VMSTAT      3   // major device number of the vmstat device
+
+struct vmstat {
+  uint totalpages;             // physical frames for user and kernel pages
+  uint freepages;
+  uint kallocfail;             // kalloc() calls that found no free frame
+  uint faults;                 // swap-ins since boot, all processes
+  uint pageouts;               // swap-outs since boot, all processes
+  uint swapused;               // swap file places in use
+  uint swapslots;              // swap file places of the processes with one
+  uint swappooled;             // swap files kept for reuse
+  uint policyticks;            // clock ticks of the replacement policies run
+  uint policycycles;           // cycles they took (wraps: use differences)
+  uint nproc;                  // struct vmproc that follow
+};
+
+struct vmproc {
+  int pid;
+  char name[16];
+  int policy;                  // POLICY_* from policy.h
+  uint size;                   // pages of memory (sz)
+  uint resident;               // pages tracked in memory
+  uint swapped;                // pages in the swap file
+  uint faults;
+  uint pageouts;
+};